@@ -51,6 +51,15 @@ set(CMAKE_CXX_EXTENSIONS OFF)
 # event logging
 option(LOG_EVENTS "log event handling stats" OFF)
 
+# monitors
+option(USE_RANDR "get monitors from RandR 1.5 and follow hotplug events, instead of Xinerama" ON)
+
+# bar rendering
+option(RASTER_BAR "rasterize the bar client side and upload it with MIT-SHM" OFF)
+
+# tests
+option(BUILD_TESTS "build the tests (run with ctest) and benchmarks in tests/" OFF)
+
 # Compile commands
 option(CMAKE_EXPORT_COMPILE_COMMANDS "generate compile_commands.json" ON)
 
@@ -8,6 +8,37 @@ function (target_link_xinerama target access succ)
     endif ()
 endfunction ()
 
+function (target_link_randr target access succ)
+    find_package(X11 OPTIONAL_COMPONENTS Xrandr)
+    if (X11_Xrandr_FOUND)
+        target_link_libraries(${target} ${access} X11::Xrandr)
+        set(${succ} YES PARENT_SCOPE)
+    else ()
+        set(${succ} NO PARENT_SCOPE)
+    endif ()
+endfunction ()
+
+function (target_link_xsync target access succ)
+    find_package(X11 OPTIONAL_COMPONENTS Xext)
+    if (X11_Xext_FOUND AND X11_XSync_FOUND)
+        target_link_libraries(${target} ${access} X11::Xext)
+        set(${succ} YES PARENT_SCOPE)
+    else ()
+        set(${succ} NO PARENT_SCOPE)
+    endif ()
+endfunction ()
+
+function (target_link_raster target access succ)
+    find_package(X11 OPTIONAL_COMPONENTS Xext)
+    find_package(Freetype)
+    if (X11_Xext_FOUND AND X11_XShm_FOUND AND FREETYPE_FOUND)
+        target_link_libraries(${target} ${access} X11::Xext Freetype::Freetype)
+        set(${succ} YES PARENT_SCOPE)
+    else ()
+        set(${succ} NO PARENT_SCOPE)
+    endif ()
+endfunction ()
+
 function (target_link_x11 target access)
     find_package(X11 REQUIRED ${ARGN})
     foreach (module ${ARGN})
@@ -0,0 +1,137 @@
+#ifndef DWM_BAR_HPP
+#define DWM_BAR_HPP
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Remembers what was last drawn into each segment (status, tags, layout symbol, title) of a bar's back buffer.
+ *
+ * `drawbar` computes a content key for every segment and only re-renders the ones where it changed. The back buffer
+ * keeps the pixels of the rest, and only the area which was re-rendered gets copied to the bar window.
+ */
+struct BarSegments {
+    struct Damage {
+        int x;
+        int w;
+    };
+private:
+    struct Segment {
+        std::uint64_t key = 0;
+        bool valid = false;
+    };
+
+    std::vector<Segment> m_segments;
+    std::vector<Damage> m_damage;
+    std::vector<Damage> m_overdrawn;
+
+    [[nodiscard]]
+    static bool intersects(Damage const &d, int x, int w) {
+        return x < d.x + d.w && d.x < x + w;
+    }
+
+public:
+    /**
+     * Returns true if segment `idx` at [x, x + w) has to be re-rendered, i.e. its key changed or a segment drawn
+     * earlier in this frame overlapped it.
+     */
+    [[nodiscard]]
+    bool update(std::size_t idx, int x, int w, std::uint64_t key) {
+        if (idx >= m_segments.size()) m_segments.resize(idx + 1);
+        auto &seg = m_segments[idx];
+
+        bool overdrawn = std::ranges::any_of(m_damage, [&](Damage const &d) { return intersects(d, x, w); });
+        if (seg.valid && seg.key == key && !overdrawn) return false;
+
+        seg = {.key = key, .valid = true};
+        if (w > 0) m_damage.push_back({x, w});
+        return true;
+    }
+
+    /// Something other than `drawbar` drew over [x, x + w), segments there have to be redrawn next frame
+    void invalidate(int x, int w) {
+        m_overdrawn.push_back({x, w});
+    }
+
+    /// The back buffer was reallocated, everything has to be redrawn
+    void invalidate() {
+        m_segments.clear();
+    }
+
+    /// Bounding box of everything re-rendered since the last call, to be copied to the window
+    [[nodiscard]]
+    std::optional<Damage> takeDamage() {
+        if (m_damage.empty()) return std::nullopt;
+        auto begin = std::ranges::min(m_damage, {}, &Damage::x).x;
+        auto end = std::ranges::max(m_damage | std::views::transform([](Damage const &d) { return d.x + d.w; }));
+        m_damage.clear();
+        return Damage {.x = begin, .w = end - begin};
+    }
+
+    /// Start a new frame, areas passed to `invalidate(x, w)` count as already drawn over in it
+    void begin() {
+        m_damage = std::exchange(m_overdrawn, {});
+    }
+};
+
+/**
+ * What a click on each part of the bar hits, recorded by `drawbar` while it lays out the segments so that hit
+ * testing always matches what was drawn and does not have to measure any text.
+ */
+struct BarHitMap {
+    struct Region {
+        /// One past the last pixel of the region, regions are contiguous and start at 0
+        int end;
+        unsigned int click;
+        unsigned int tag;
+    };
+private:
+    std::vector<Region> m_regions;
+
+public:
+    void clear() {
+        m_regions.clear();
+    }
+
+    /// Append a region ending at `end`, regions have to be added left to right. Empty regions are ignored.
+    void add(int end, unsigned int click, unsigned int tag = 0) {
+        if (!m_regions.empty() && end <= m_regions.back().end) return;
+        m_regions.push_back({.end = end, .click = click, .tag = tag});
+    }
+
+    [[nodiscard]]
+    std::optional<Region> find(int x) const {
+        if (x < 0) return std::nullopt;
+        auto it = std::ranges::upper_bound(m_regions, x, {}, &Region::end);
+        if (it == m_regions.end()) return std::nullopt;
+        return *it;
+    }
+};
+
+/// Content key for a bar segment, strings are hashed by content, everything else by value
+template<typename... Ts>
+[[nodiscard]]
+std::uint64_t segmentKey(Ts const &...parts) {
+    std::uint64_t hash = fnv1a({});
+    auto add = [&]<typename T>(T const &part) {
+        if constexpr (std::is_convertible_v<T const &, std::string_view>) {
+            hash = fnv1a(std::string_view {part}, hash);
+            hash = fnv1a({"", 1}, hash);
+        } else {
+            static_assert(std::is_trivially_copyable_v<T>);
+            hash = fnv1a({reinterpret_cast<char const *>(&part), sizeof(part)}, hash);
+        }
+    };
+    (add(parts), ...);
+    return hash;
+}
+
+#endif  // DWM_BAR_HPP
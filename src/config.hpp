@@ -24,6 +24,9 @@ inline constexpr auto fonts = std::array {
     "JetBrainsMono Nerd Font:size=" NERD_FONT_SIZE ":antialias=true:autohint=true",
     "Noto Emoji:size=" FONT_SIZE ":antialias=true:autohint=true",
 };
+/* fonts found by fontconfig for characters missing from the fonts above are kept in an LRU cache */
+static constexpr std::size_t fallback_font_memory = 4 * 1024 * 1024; /* bytes shared by all fallback fonts */
+static constexpr int fallback_font_glyph_memory = 256 * 1024;        /* glyph cache limit of a single fallback font */
 static constexpr char const *dmenufont = "JetBrains Mono:size=" FONT_SIZE ":antialias=true:autohint=true";
 static constexpr char const *dmenulines = "20";
 static constexpr char const *dmenuborder = "3";
@@ -33,6 +36,9 @@ static constexpr char const *dmenuopacity = "0.8";
 static int const bright_time = 60;             /* time in useconds to go from one screen brightness value to the next*/
 static int const bright_steps = 20;            /* number of steps it takes to move between brightness values */
 
+static int const title_refresh_ms = 100; /* the title of the selected client is reread at most this often */
+static int const sync_timeout_ms = 250;  /* stop waiting for a client to redraw while resizing it after this long */
+
 static double const progress_fade_time = 1.5;  // How long progress bar will not disapear for (in seconds)
 
 
@@ -151,6 +157,8 @@ static constexpr auto rules = std::array {
 static constexpr float mfact = 0.5;       /* factor of master area size [0.05..0.95] */
 static constexpr int nmaster = 1;         /* number of clients in master area */
 static constexpr bool resizehints = true; /* 1 means respect size hints in tiled resizals */
+static constexpr int tiled_min_size = 48; /* tiled clients are not made smaller than this, extras are parked off-screen */
+static constexpr Occluded hide_occluded = Occluded::keep; /* tiled clients under the monocle or a fullscreen client */
 
 static auto const layouts = std::array {
     /*       symbol      arrange function */
@@ -3,94 +3,80 @@
 
 #include "colors.hpp"
 #include "log.hpp"
+#include "utf8.hpp"
 #include "util.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <span>
 
-#define UTF_INVALID 0xFFFD
-#define UTF_SIZ     4uz
+namespace rng = std::ranges;
 
-static unsigned char const utfbyte[UTF_SIZ + 1] = {0x80, 0, 0xC0, 0xE0, 0xF0};
-static unsigned char const utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
-static long const utfmin[UTF_SIZ + 1] = {0, 0, 0x80, 0x800, 0x10000};
-static long const utfmax[UTF_SIZ + 1] = {0x10FFFF, 0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
+/* the memo is dropped once it grows past this, it mostly holds window titles and status text */
+static constexpr std::size_t max_text_layouts = 256;
 
-static long utf8decodebyte(char const c, size_t *i) {
-    for (*i = 0; *i < (UTF_SIZ + 1); ++(*i)) {
-        if (((unsigned char)c & utfmask[*i]) == utfbyte[*i]) {
-            return (unsigned char)c & ~utfmask[*i];
-        }
-    }
-    return 0;
-}
-
-static size_t utf8validate(long *u, size_t i) {
-    if (!between(*u, utfmin[i], utfmax[i]) || between(*u, 0xD800, 0xDFFF)) {
-        *u = UTF_INVALID;
-    }
-    for (i = 1; *u > utfmax[i]; ++i) {
-        ;
-    }
-    return i;
-}
-
-static size_t utf8decode(char const *c, long *u, size_t clen) {
-    size_t i;
-    size_t j;
-    size_t len;
-    size_t type;
-    long udecoded;
-
-    *u = UTF_INVALID;
-    if (!clen) {
-        return 0;
-    }
-    udecoded = utf8decodebyte(c[0], &len);
-    if (!between(len, 1uz, UTF_SIZ)) {
-        return 1;
-    }
-    for (i = 1, j = 1; i < clen && j < len; ++i, ++j) {
-        udecoded = (udecoded << 6) | utf8decodebyte(c[i], &type);
-        if (type) {
-            return j;
-        }
-    }
-    if (j < len) {
-        return 0;
-    }
-    *u = udecoded;
-    utf8validate(u, len);
-
-    return len;
-}
-
-Drw::Drw(Display *dpy, int screen, Window root, unsigned int width, unsigned int height)
-        : m_screen_width(width)
-        , m_screen_height(height)
-        , m_dpy(dpy)
+Drw::Drw(Display *dpy, int screen, Window root)
+        : m_dpy(dpy)
         , m_screen(screen)
         , m_root(root)
-        , m_drawable(XCreatePixmap(dpy, root, width, height, (unsigned)DefaultDepth(dpy, screen)))
         , m_gc(XCreateGC(dpy, root, 0, nullptr))
         , m_cursors(dpy) {
     XSetLineAttributes(m_dpy, m_gc, 1, LineSolid, CapButt, JoinMiter);
 }
 
 Drw::~Drw() {
-    XFreePixmap(m_dpy, m_drawable);
+    if (m_font_cache) m_font_cache->save();
+    for (auto &[_, buf] : m_buffers)
+        freeBuffer(buf);
+    for (auto &[_, rgb] : m_rgb_colors)
+        XftColorFree(m_dpy, DefaultVisual(m_dpy, m_screen), DefaultColormap(m_dpy, m_screen), &rgb.color);
     XFreeGC(m_dpy, m_gc);
     drw_fontset_free(m_fonts);
 }
 
-void Drw::resize(unsigned int w, unsigned int h) {
-    m_screen_width = w;
-    m_screen_height = h;
-    if (m_drawable) XFreePixmap(m_dpy, m_drawable);
-    m_drawable = XCreatePixmap(m_dpy, m_root, w, h, (unsigned)DefaultDepth(m_dpy, m_screen));
+bool Drw::target(Window win, unsigned int w, unsigned int h) {
+    auto &buf = m_buffers[win];
+    if (&buf != m_target) flush();
+    bool realloc = buf.w != w || buf.h != h;
+    if (realloc) {
+        freeBuffer(buf);
+        if (auto raster = RasterImage::create(m_dpy, m_screen, w, h)) {
+            buf = {.raster = std::move(raster), .w = w, .h = h};
+        } else {
+            auto pixmap = XCreatePixmap(m_dpy, m_root, w, h, (unsigned)DefaultDepth(m_dpy, m_screen));
+            buf = {
+                .raster = std::nullopt,
+                .pixmap = pixmap,
+                .xft = XftDrawCreate(m_dpy, pixmap, DefaultVisual(m_dpy, m_screen), DefaultColormap(m_dpy, m_screen)),
+                .w = w,
+                .h = h,
+            };
+        }
+    }
+    m_target = &buf;
+    return realloc;
+}
+
+void Drw::release(Window win) {
+    if (auto it = m_buffers.find(win); it != m_buffers.end()) {
+        if (m_target == &it->second) {
+            /* queued drawing would go to a freed buffer */
+            m_pending_fills.clear();
+            m_pending_texts.clear();
+            m_target = nullptr;
+        }
+        freeBuffer(it->second);
+        m_buffers.erase(it);
+    }
+}
+
+void Drw::freeBuffer(DrawBuffer &buf) {
+    if (buf.xft) XftDrawDestroy(buf.xft);
+    if (buf.pixmap) XFreePixmap(m_dpy, buf.pixmap);
+    buf = {};
 }
 
 /* This function is an implementation detail. Library users should use
@@ -148,20 +134,152 @@ static void xfont_free(Fnt const &font) {
     // TODO(dk949): consider making this the destructor for Fnt
     if (font.pattern) FcPatternDestroy(font.pattern);
 
+    rasterFontClosed(font.xfont);
     XftFontClose(font.dpy, font.xfont);
 }
 
 bool Drw::fontset_create(std::span<char const *const> fonts) {
 
     bool success = false;
-    for (auto const *font_name : fonts)
+    for (auto const *font_name : fonts) {
+        m_fontset_hash = fnv1a(font_name, m_fontset_hash);
         if (auto xfont = xfont_create(font_name)) {
-            m_fonts.push_back(*xfont);
+            addFont(*xfont);
             success = true;
         }
+    }
+    m_primary_font_count = m_fonts.size();
     return success;
 }
 
+void Drw::loadFontCache(std::filesystem::path path) {
+    m_font_cache.emplace(std::move(path), m_fontset_hash);
+}
+
+void Drw::setFallbackFontBudget(std::size_t budget, int glyph_memory) {
+    m_fallback_budget = budget;
+    m_fallback_glyph_memory = glyph_memory;
+}
+
+void Drw::addFont(Fnt const &font) {
+    m_fonts.push_back(font);
+    m_font_generation++;
+    m_coverage.addFont(font.xfont->charset);
+}
+
+std::optional<Fnt> Drw::findFallbackFont(FcChar32 codepoint) {
+    if (m_coverage.full()) return std::nullopt;
+
+    if (!m_fonts.front().pattern) {
+        /* Refer to the comment in xfont_create for more information. */
+        lg::fatal("the first font in the cache must be loaded from a font string.");
+    }
+
+    if (auto cached = m_font_cache ? m_font_cache->find(codepoint) : std::nullopt) {
+        if (!cached->file) return std::nullopt;
+
+        /* The cache already knows the file, so only the fontset search is skipped. The pattern goes through the same
+         * substitutions as XftFontMatch does below, with the file standing in for the match, so that fonts.conf rules
+         * apply the same way they would on a cold start. */
+        FcPattern *fcpattern = FcPatternDuplicate(m_fonts.front().pattern);
+        FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+        FcPatternAddString(fcpattern, FC_FILE, (FcChar8 const *)cached->file);
+        FcPatternAddInteger(fcpattern, FC_INDEX, cached->index);
+        FcConfigSubstitute(nullptr, fcpattern, FcMatchPattern);
+        FcDefaultSubstitute(fcpattern);
+        XftDefaultSubstitute(m_dpy, m_screen, fcpattern);
+
+        int count = 0;
+        FcPattern *filepattern =
+            FcFreeTypeQuery((FcChar8 const *)cached->file, (unsigned)cached->index, nullptr, &count);
+        FcPattern *match = filepattern ? FcFontRenderPrepare(nullptr, fcpattern, filepattern) : nullptr;
+        if (filepattern) FcPatternDestroy(filepattern);
+        FcPatternDestroy(fcpattern);
+        if (auto font = match ? openFallbackFont(match, codepoint) : std::nullopt) return font;
+
+        lg::warn("font cache is out of date, could not use '{}' for U+{:04X}", cached->file, codepoint);
+        m_font_cache->invalidate();
+    }
+
+    XftResult result;
+    FcCharSet *fccharset = FcCharSetCreate();
+    FcCharSetAddChar(fccharset, codepoint);
+
+    FcPattern *fcpattern = FcPatternDuplicate(m_fonts.front().pattern);
+    FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
+    FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+
+    FcConfigSubstitute(nullptr, fcpattern, FcMatchPattern);
+    FcDefaultSubstitute(fcpattern);
+    FcPattern *match = XftFontMatch(m_dpy, m_screen, fcpattern, &result);
+
+    FcCharSetDestroy(fccharset);
+    FcPatternDestroy(fcpattern);
+
+    auto font = match ? openFallbackFont(match, codepoint) : std::nullopt;
+    if (m_font_cache) {
+        FcChar8 *file = nullptr;
+        int index = 0;
+        if (font) {
+            FcPatternGetString(font->xfont->pattern, FC_FILE, 0, &file);
+            FcPatternGetInteger(font->xfont->pattern, FC_INDEX, 0, &index);
+        }
+        m_font_cache->record(codepoint, (char const *)file, index);
+    }
+    return font;
+}
+
+/* Takes ownership of `pattern` */
+std::optional<Fnt> Drw::openFallbackFont(FcPattern *pattern, FcChar32 codepoint) {
+    /* bound the glyph cache so that the font can be accounted for in the fallback budget */
+    FcPatternDel(pattern, XFT_MAX_GLYPH_MEMORY);
+    FcPatternAddInteger(pattern, XFT_MAX_GLYPH_MEMORY, m_fallback_glyph_memory);
+    /* on success the font takes ownership of `pattern` */
+    auto font = xfont_create(pattern);
+    if (!font) {
+        FcPatternDestroy(pattern);
+        return std::nullopt;
+    }
+    if (!XftCharExists(m_dpy, font->xfont, codepoint)) {
+        xfont_free(*font);
+        return std::nullopt;
+    }
+    return font;
+}
+
+void Drw::addFallbackFont(Fnt const &font) {
+    /* The glyph cache is capped by XFT_MAX_GLYPH_MEMORY (as is the one in raster.cpp, when it is compiled in), on top
+     * of that Xft keeps a glyph pointer per character the font has. */
+    auto memory = (std::size_t)m_fallback_glyph_memory * (rasterIsAvailable() ? 2 : 1)
+                + (font.xfont->charset ? FcCharSetCount(font.xfont->charset) : 0uz) * sizeof(void *);
+    addFont(font);
+    m_fallback_fonts.push_back({.last_used = ++m_font_clock, .memory = memory});
+    m_fallback_memory += memory;
+}
+
+void Drw::touchFont(std::size_t idx) {
+    if (idx >= m_primary_font_count) m_fallback_fonts[idx - m_primary_font_count].last_used = ++m_font_clock;
+}
+
+void Drw::evictFallbackFonts(std::uint64_t since) {
+    /* queued text refers to fonts by index */
+    if (m_fallback_memory > m_fallback_budget) flush();
+    while (m_fallback_memory > m_fallback_budget && !m_fallback_fonts.empty()) {
+        auto lru = std::ranges::min_element(m_fallback_fonts, {}, &FallbackFont::last_used);
+        /* text which needs more fonts than the budget allows goes over it, rather than reopening them every redraw */
+        if (lru->last_used > since) break;
+        auto fallback_idx = (std::size_t)(lru - m_fallback_fonts.begin());
+        auto font_idx = m_primary_font_count + fallback_idx;
+
+        m_fallback_memory -= lru->memory;
+        m_fallback_fonts.erase(lru);
+        xfont_free(m_fonts[font_idx]);
+        m_fonts.erase(m_fonts.begin() + (std::ptrdiff_t)font_idx);
+        m_coverage.removeFont(font_idx);
+        m_font_generation++;
+    }
+}
+
 void drw_fontset_free(std::vector<Fnt> &fonts) {
     for (auto const &font : fonts)
         xfont_free(font);
@@ -192,181 +310,250 @@ void Drw::setColorScheme(ColorSchemeName clrnames) {
     DRW_COLOR_SCHEME_FIELDS_FOREACH()
 }
 
+Color const *Drw::schemeByName(std::string_view name) const {
+#undef DRW_COLOR_SCHEME_FIELDS_DO
+#define DRW_COLOR_SCHEME_FIELDS_DO(f) \
+    if (name == #f) return &m_scheme.f;
+    DRW_COLOR_SCHEME_FIELDS_FOREACH()
+    return nullptr;
+}
+
+XftColor const &Drw::rgbColor(std::uint32_t rgb) {
+    if (auto it = m_rgb_colors.find(rgb); it != m_rgb_colors.end()) {
+        it->second.used = true;
+        return it->second.color;
+    }
+
+    /* X colors have 16 bits per channel */
+    XRenderColor value = {
+        .red = (unsigned short)(((rgb >> 16) & 0xFF) * 0x101),
+        .green = (unsigned short)(((rgb >> 8) & 0xFF) * 0x101),
+        .blue = (unsigned short)((rgb & 0xFF) * 0x101),
+        .alpha = 0xFFFF,
+    };
+    XftColor out;
+    if (!XftColorAllocValue(m_dpy, DefaultVisual(m_dpy, m_screen), DefaultColormap(m_dpy, m_screen), &value, &out)) {
+        lg::warn("cannot allocate color #{:06X}", rgb);
+        return m_scheme.status.fg;
+    }
+    return m_rgb_colors.emplace(rgb, RgbColor {.color = out, .used = true}).first->second.color;
+}
+
+void Drw::pruneRgbColors() {
+    /* queued text holds copies of the colors */
+    flush();
+    for (auto it = m_rgb_colors.begin(); it != m_rgb_colors.end();) {
+        if (std::exchange(it->second.used, false)) {
+            ++it;
+            continue;
+        }
+        XftColorFree(m_dpy, DefaultVisual(m_dpy, m_screen), DefaultColormap(m_dpy, m_screen), &it->second.color);
+        it = m_rgb_colors.erase(it);
+    }
+}
+
 // TODO(dk949): make the bools strongly typed
 void Drw::draw_rect(int x, int y, unsigned int w, unsigned int h, bool filled, bool invert) {
-    if (!m_current_color) return;
+    if (!m_current_color || !m_target) return;
+
+    auto pixel = invert ? currentColor().bg.pixel : currentColor().fg.pixel;
+    XRectangle rect = {(short)x, (short)y, (unsigned short)w, (unsigned short)h};
+    if (filled) {
+        fill(pixel, rect);
+    } else if (m_target->raster) {
+        flush();
+        m_target->raster->outline(rect, pixel);
+    } else {
+        flush();
+        setForeground(pixel);
+        XDrawRectangle(m_dpy, m_target->pixmap, m_gc, x, y, w - 1, h - 1);
+    }
+}
 
-    XSetForeground(m_dpy, m_gc, invert ? currentColor().bg.pixel : currentColor().fg.pixel);
-    if (filled)
-        XFillRectangle(m_dpy, m_drawable, m_gc, x, y, w, h);
+static bool intersects(XRectangle const &a, XRectangle const &b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+void Drw::setForeground(unsigned long pixel) {
+    if (m_gc_foreground == pixel) return;
+    XSetForeground(m_dpy, m_gc, pixel);
+    m_gc_foreground = pixel;
+}
+
+void Drw::fill(unsigned long pixel, XRectangle rect) {
+    /* fills are sent before text, and fills of different colors may be reordered */
+    if (rng::any_of(m_pending_texts, [&](auto const &t) { return intersects(t.rect, rect); })
+        || rng::any_of(m_pending_fills, [&](auto const &f) {
+               return f.pixel != pixel && rng::any_of(f.rects, [&](auto const &r) { return intersects(r, rect); });
+           }))
+        flush();
+
+    if (auto it = rng::find(m_pending_fills, pixel, &PendingFill::pixel); it != m_pending_fills.end())
+        it->rects.push_back(rect);
     else
-        XDrawRectangle(m_dpy, m_drawable, m_gc, x, y, w - 1, h - 1);
+        m_pending_fills.push_back({.pixel = pixel, .rects = {rect}});
+}
+
+void Drw::flush() {
+    for (auto &f : m_pending_fills) {
+        if (m_target->raster) {
+            for (auto const &rect : f.rects)
+                m_target->raster->fill(rect, f.pixel);
+        } else {
+            setForeground(f.pixel);
+            XFillRectangles(m_dpy, m_target->pixmap, m_gc, f.rects.data(), (int)f.rects.size());
+        }
+    }
+    m_pending_fills.clear();
+
+    for (auto const &t : m_pending_texts) {
+        int run_x = t.rect.x;
+        for (auto const &run : t.layout->runs) {
+            if (run.begin >= t.text_end) break;
+
+            auto const &font = m_fonts[run.font];
+            auto ty = (unsigned)t.rect.y + (t.rect.height - font.h) / 2 + (unsigned)font.xfont->ascent;
+            std::string_view text {t.layout->text.data() + run.begin, std::min(run.end, t.text_end) - run.begin};
+            if (m_target->raster)
+                m_target->raster->drawText(font.xfont, t.color, run_x, (int)ty, text);
+            else
+                XftDrawStringUtf8(m_target->xft,
+                    &t.color,
+                    font.xfont,
+                    run_x,
+                    (int)ty,
+                    (XftChar8 const *)text.data(),
+                    (int)text.size());
+            run_x += (int)run.advance;
+        }
+    }
+    m_pending_texts.clear();
 }
 
 // TODO(dk949): make the bools strongly typed
 int Drw::draw_text(int x, int y, unsigned int w, unsigned int h, unsigned int lpad, char const *text, bool invert) {
-    int ellipsis_x = 0;
-    unsigned int tmpw = 0;
-    unsigned int ellipsis_w = 0;
-    XftDraw *d = nullptr;
-    int render = x || y || w || h;
-    long utf8codepoint = 0;
-    XftResult result;
-    int charexists = 0, overflow = 0;
-
-    // TODO(dk949): use an actual UTF-8 library
-
-    /* keep track of a couple codepoints for which we have no match. */
-    static constexpr auto nomatches_len = 64;
+    auto const call_start = m_font_clock;
+    auto out = draw_text_impl(x, y, w, h, lpad, text, invert);
+    /* fallback fonts are only closed here, once nothing is still drawing with them */
+    evictFallbackFonts(call_start);
+    if (m_layouts.size() > max_text_layouts) m_layouts.clear();
+    return out;
+}
 
-    static struct {
-        long codepoint[nomatches_len];
-        unsigned int idx;
-    } nomatches;
+int Drw::draw_text_impl(int x, int y, unsigned int w, unsigned int h, unsigned int lpad, char const *text, bool invert) {
+    int render = x || y || w || h;
 
-    static unsigned int ellipsis_width = 0;
+    if ((render && (!m_current_color || !m_target || !w)) || !text) return 0;
 
-    if ((render && (!m_current_color || !w)) || !text) return 0;
+    auto layout = layout_text(text);
+    for (auto const &run : layout->runs)
+        touchFont(run.font);
 
     if (!render) {
+        /* measuring, with invert the width up to and including the first codepoint is returned */
         w = invert ? 1u : ~0u;
-    } else {
-        XSetForeground(m_dpy, m_gc, currentColor().invert(invert).bg.pixel);
-        XFillRectangle(m_dpy, m_drawable, m_gc, x, y, w, h);
-        d = XftDrawCreate(m_dpy, m_drawable, DefaultVisual(m_dpy, m_screen), DefaultColormap(m_dpy, m_screen));
-        x += (int)lpad;
-        w -= lpad;
+        if (layout->width <= w) return x + (int)layout->width;
+        auto over = std::ranges::find_if(layout->boundaries, [&](auto const &b) { return b.x > w; });
+        return x + (int)over->x;
     }
 
-    Fnt usedfont = m_fonts.front();
-    if (!ellipsis_width && render) ellipsis_width = fontset_getwidth("...");
-    while (true) {
-        unsigned ew = 0;
-        std::size_t ellipsis_len = 0;
-        std::size_t utf8strlen = 0;
-        char const *utf8str = text;
-        std::optional<Fnt> nextfont = std::nullopt;
-        while (*text) {
-            auto utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
-            for (auto &curfont : m_fonts) {
-                charexists = charexists || XftCharExists(m_dpy, curfont.xfont, (FcChar32)utf8codepoint);
-                if (charexists) {
-                    drw_font_getexts(&curfont, text, utf8charlen, &tmpw, nullptr);
-                    if (ew + ellipsis_width <= w) {
-                        /* keep track where the ellipsis still fits */
-                        ellipsis_x = (int)((unsigned)x + ew);
-                        ellipsis_w = w - ew;
-                        ellipsis_len = utf8strlen;
-                    }
-
-                    if (ew + tmpw > w) {
-                        overflow = 1;
-                        /* called from drw_fontset_getwidth_clamp():
-                         * it wants the width AFTER the overflow
-                         */
-                        if (!render)
-                            x += (int)tmpw;
-                        else
-                            utf8strlen = ellipsis_len;
-                    } else if (curfont == usedfont) {
-                        utf8strlen += utf8charlen;
-                        text += utf8charlen;
-                        ew += tmpw;
-                    } else {
-                        nextfont = curfont;
-                    }
-                    break;
-                }
-            }
-
-            if (overflow || !charexists || nextfont) {
-                break;
-            }
-            charexists = 0;
+    fill(currentColor().invert(invert).bg.pixel, {(short)x, (short)y, (unsigned short)w, (unsigned short)h});
+    x += (int)lpad;
+    w -= lpad;
+
+    auto text_end = (std::uint32_t)layout->text.size();
+    auto text_width = layout->width;
+    std::optional<unsigned> ellipsis_x = std::nullopt;
+    if (layout->width > w) {
+        /* cut at the last codepoint after which the ellipsis still fits */
+        auto ellipsis_width = layout_text("...")->width;
+        auto cut = std::ranges::partition_point(layout->boundaries,
+            [&](auto const &b) { return b.x + ellipsis_width <= w; });
+        if (cut != layout->boundaries.begin()) {
+            --cut;
+            text_end = cut->byte;
+            text_width = cut->x;
+            ellipsis_x = cut->x;
+        } else {
+            text_end = 0;
+            text_width = 0;
+            if (ellipsis_width <= w) ellipsis_x = 0;
         }
+    }
 
-        if (utf8strlen) {
-            if (render) {
-                auto ty = (unsigned)y + (h - usedfont.h) / 2 + (unsigned)usedfont.xfont->ascent;
-                XftDrawStringUtf8(d,
-                    &currentColor().invert(invert).fg,
-                    usedfont.xfont,
-                    x,
-                    (int)ty,
-                    (XftChar8 *)utf8str,
-                    (int)utf8strlen);
-            }
-            x += (int)ew;
-            w -= ew;
-        }
-        if (render && overflow) draw_text(ellipsis_x, y, ellipsis_w, h, 0, "...", invert);
+    if (text_end)
+        m_pending_texts.push_back({
+            .layout = layout,
+            .color = currentColor().invert(invert).fg,
+            .rect = {(short)x, (short)y, (unsigned short)text_width, (unsigned short)h},
+            .text_end = text_end,
+        });
+    if (ellipsis_x) draw_text_impl(x + (int)*ellipsis_x, y, w - *ellipsis_x, h, 0, "...", invert);
 
-        if (!*text || overflow) {
-            break;
-        } else if (nextfont) {
-            charexists = 0;
-            usedfont = *nextfont;
-        } else {
-            /* Regardless of whether or not a fallback font is found, the
-             * character must be drawn. */
-            charexists = 1;
-
-            bool no_match = false;
-            for (int i = 0; i < nomatches_len; ++i) {
-                /* avoid calling XftFontMatch if we know we won't find a match */
-                if (utf8codepoint == nomatches.codepoint[i]) {
-                    no_match = true;
-                    usedfont = m_fonts.front();
-                    break;
-                }
-            }
-
-
-            if (!no_match) {
-
-                FcCharSet *fccharset = FcCharSetCreate();
-                FcCharSetAddChar(fccharset, (FcChar32)utf8codepoint);
-
-                if (!m_fonts.front().pattern) {
-                    /* Refer to the comment in xfont_create for more information. */
-                    lg::fatal("the first font in the cache must be loaded from a font string.");
-                }
-
-                FcPattern *fcpattern = FcPatternDuplicate(m_fonts.front().pattern);
-                FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-                FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-
-                FcConfigSubstitute(nullptr, fcpattern, FcMatchPattern);
-                FcDefaultSubstitute(fcpattern);
-                FcPattern *match = XftFontMatch(m_dpy, m_screen, fcpattern, &result);
-
-                FcCharSetDestroy(fccharset);
-                FcPatternDestroy(fcpattern);
-
-                // TODO(dk949): the `match` is never deleted???
-                if (match) {
-                    auto new_font = xfont_create(match);
-                    if (new_font && XftCharExists(m_dpy, new_font->xfont, (FcChar32)utf8codepoint)) {
-                        usedfont = *new_font;
-                        m_fonts.push_back(usedfont);
-                    } else {
-                        if (new_font) xfont_free(*new_font);
-                        nomatches.codepoint[++nomatches.idx % nomatches_len] = utf8codepoint;
-                        usedfont = m_fonts.front();
-                    }
-                }
-            }
+    return x + (int)w;
+}
+
+std::shared_ptr<Drw::TextLayout const> Drw::layout_text(std::string_view text) {
+    auto key = [&] { return fnv1a(text) ^ (m_font_generation * 0x9E3779B97F4A7C15); };
+
+    if (auto it = m_layouts.find(key()); it != m_layouts.end() && it->second->text == text) return it->second;
+
+    /* shaping can load fallback fonts, which changes the generation */
+    auto layout = shape_text(text);
+    m_layouts.insert_or_assign(key(), layout);
+    return layout;
+}
+
+std::shared_ptr<Drw::TextLayout const> Drw::shape_text(std::string_view text) {
+    auto layout = std::make_shared<TextLayout>();
+    layout->text = text;
+    std::vector<utf8::Codepoint> codepoints;
+    utf8::decode(text, codepoints);
+    layout->boundaries.reserve(codepoints.size());
+
+    /* fonts are referred to by index, m_fonts may grow while the text is being shaped */
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < codepoints.size();) {
+        auto codepoint = (FcChar32)codepoints[i].value;
+        std::size_t charlen = codepoints[i].len;
+        std::size_t font_idx = m_coverage.find(codepoint);
+        if (font_idx == FontCoverage::missing) {
+            if (auto new_font = findFallbackFont(codepoint))
+                addFallbackFont(*new_font);
+            else
+                /* avoid looking for a fallback again if we know we won't find a match */
+                m_coverage.markNoMatch(codepoint);
+            continue;
         }
-    }
-    if (d) {
-        XftDrawDestroy(d);
+        /* Regardless of whether or not a fallback font was found, the
+         * character must be drawn. */
+        if (font_idx == FontCoverage::no_match) font_idx = 0;
+
+        unsigned advance = 0;
+        drw_font_getexts(&m_fonts[font_idx], text.data() + pos, charlen, &advance, nullptr);
+
+        if (layout->runs.empty() || layout->runs.back().font != font_idx)
+            layout->runs.push_back({.font = font_idx, .begin = (std::uint32_t)pos, .end = (std::uint32_t)pos, .advance = 0});
+        pos += charlen;
+        layout->width += advance;
+        layout->runs.back().end = (std::uint32_t)pos;
+        layout->runs.back().advance += advance;
+        layout->boundaries.push_back({.byte = (std::uint32_t)pos, .x = layout->width});
+        i++;
     }
 
-    return (int)((unsigned)x + (render ? w : 0));
+    return layout;
 }
 
 void Drw::map(Window win, int x, int y, unsigned int w, unsigned int h) {
-    XCopyArea(m_dpy, m_drawable, win, m_gc, x, y, w, h, x, y);
+    flush();
+    auto it = m_buffers.find(win);
+    if (it == m_buffers.end()) return;
+    if (it->second.raster)
+        it->second.raster->put(win, m_gc, x, y, w, h);
+    else
+        XCopyArea(m_dpy, it->second.pixmap, win, m_gc, x, y, w, h, x, y);
+    /* also makes sure the server is done reading a shared memory image before it is drawn into again */
     XSync(m_dpy, False);
 }
 
@@ -3,14 +3,23 @@
 #define DWM_DRW_HPP
 
 #include "colors.hpp"
+#include "font_cache.hpp"
+#include "font_coverage.hpp"
+#include "raster.hpp"
 #include "xidptr.hpp"
 
 #include <X11/cursorfont.h>
 #include <X11/Xft/Xft.h>
 #include <X11/Xlib.h>
 
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <optional>
 #include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 
 enum struct CurShape : unsigned { Normal = XC_left_ptr, Resize = XC_sizing, Move = XC_fleur };
@@ -64,36 +73,134 @@ struct Drw {
 private:
     ColorScheme m_scheme;
     Color const *m_current_color = nullptr;
-    unsigned int m_screen_width;
-    unsigned int m_screen_height;
     Display *m_dpy;
     int m_screen;
     Window m_root;
-    Drawable m_drawable;
     GC m_gc;
+
+    /// Either a client side image (if built with `RASTER_BAR`) or a pixmap drawn into by the server
+    struct DrawBuffer {
+        std::optional<RasterImage> raster;
+        Pixmap pixmap = None;
+        XftDraw *xft = nullptr;
+        unsigned int w = 0;
+        unsigned int h = 0;
+    };
+
+    // Every bar window has its own back buffer, exactly the size of the window
+    std::unordered_map<Window, DrawBuffer> m_buffers;
+    DrawBuffer *m_target = nullptr;
+    std::optional<unsigned long> m_gc_foreground;
     std::vector<Fnt> m_fonts;
+    FontCoverage m_coverage;
+
+    struct FallbackFont {
+        std::uint64_t last_used;
+        std::size_t memory;
+    };
+
+    // Fonts from `fontset_create` are never evicted, fallback fonts found by `draw_text` come after them in `m_fonts`
+    // and are evicted least recently used first once they take up more than `m_fallback_budget` bytes. Fonts used by
+    // the `draw_text` call being evicted after are kept, even if that goes over the budget.
+    std::size_t m_primary_font_count = 0;
+    std::vector<FallbackFont> m_fallback_fonts;
+    std::size_t m_fallback_memory = 0;
+    std::size_t m_fallback_budget = 0;
+    int m_fallback_glyph_memory = 0;
+    std::uint64_t m_font_clock = 0;
+
+    /// Shaped text: which font draws which bytes, and where every codepoint ends.
+    struct TextLayout {
+        struct Run {
+            std::size_t font;
+            std::uint32_t begin;
+            std::uint32_t end;
+            unsigned advance;
+        };
+
+        struct Boundary {
+            std::uint32_t byte;
+            unsigned x;
+        };
+
+        std::string text;
+        std::vector<Run> runs;
+        /// end of each codepoint, used to find where to cut the text for the ellipsis
+        std::vector<Boundary> boundaries;
+        unsigned width = 0;
+    };
+
+    // Layouts refer to fonts by index, so they are only valid for the font generation they were made in.
+    // Bumped every time a font is added or removed.
+    std::uint64_t m_font_generation = 0;
+    std::unordered_map<std::uint64_t, std::shared_ptr<TextLayout const>> m_layouts;
+
+    // Drawing is queued and sent in `flush`: filled rectangles with one XFillRectangles per color, followed by text.
+    // Anything which overlaps a queued operation in a way where the order matters flushes first.
+    struct PendingFill {
+        unsigned long pixel;
+        std::vector<XRectangle> rects;
+    };
+
+    struct PendingText {
+        std::shared_ptr<TextLayout const> layout;
+        XftColor color;
+        XRectangle rect;
+        std::uint32_t text_end;
+    };
+
+    std::vector<PendingFill> m_pending_fills;
+    std::vector<PendingText> m_pending_texts;
+
+    // Colors from `rgbColor`, allocated on first use and freed by `pruneRgbColors` once nothing asks for them
+    struct RgbColor {
+        XftColor color;
+        bool used;
+    };
+
+    std::unordered_map<std::uint32_t, RgbColor> m_rgb_colors;
+
+    std::uint64_t m_fontset_hash = 0;
+    std::optional<FontCache> m_font_cache;
     Cursors m_cursors;
 
 public:
-    Drw(Display *dpy, int screen, Window win, unsigned int width, unsigned int height);
+    Drw(Display *dpy, int screen, Window win);
     Drw(Drw const &) = delete;
     Drw &operator=(Drw const &) = delete;
     Drw(Drw &&) = delete;
     Drw &operator=(Drw &&) = delete;
     ~Drw();
 
-    void resize(unsigned int w, unsigned int h);
+    /// Draw into the back buffer of `win`, which is (re)allocated if it is not `w`x`h`. Returns true if it was.
+    bool target(Window win, unsigned int w, unsigned int h);
+    /// Free the back buffer of `win`
+    void release(Window win);
     [[nodiscard]]
     bool fontset_create(std::span<char const *const> fonts);
+    /// `budget` bytes are shared between all fallback fonts, each of which has its glyph cache limited to `glyph_memory`
+    void setFallbackFontBudget(std::size_t budget, int glyph_memory);
+    /// Resolve fallback fonts through the cache at `path` before asking fontconfig. Call after `fontset_create`.
+    void loadFontCache(std::filesystem::path path);
 
 
     void setColorScheme(ColorSchemeName clrnames);
+    /// Scheme called `name` in `ColorScheme`, `nullptr` if there is none
+    [[nodiscard]]
+    Color const *schemeByName(std::string_view name) const;
+    /// Color from a 0xRRGGBB value
+    [[nodiscard]]
+    XftColor const &rgbColor(std::uint32_t rgb);
+    /// Free the colors `rgbColor` did not return since the last call
+    void pruneRgbColors();
 
     unsigned int fontset_getwidth(char const *text);
 
     int draw_text(int x, int y, unsigned int w, unsigned int h, unsigned int lpad, char const *text, bool invert);
     void draw_rect(int x, int y, unsigned int w, unsigned int h, bool filled, bool invert);
     void map(Window win, int x, int y, unsigned int w, unsigned int h);
+    /// Send all queued drawing to the server
+    void flush();
 
     inline void setColor(Color const *col) {
         m_current_color = col;
@@ -122,6 +229,18 @@ public:
 private:
     std::optional<Fnt> xfont_create(char const *fontname);
     std::optional<Fnt> xfont_create(FcPattern *fontpattern);
+    int draw_text_impl(int x, int y, unsigned int w, unsigned int h, unsigned int lpad, char const *text, bool invert);
+    void addFont(Fnt const &font);
+    std::optional<Fnt> findFallbackFont(FcChar32 codepoint);
+    std::optional<Fnt> openFallbackFont(FcPattern *pattern, FcChar32 codepoint);
+    void addFallbackFont(Fnt const &font);
+    void touchFont(std::size_t idx);
+    void evictFallbackFonts(std::uint64_t since);
+    void freeBuffer(DrawBuffer &buf);
+    void setForeground(unsigned long pixel);
+    void fill(unsigned long pixel, XRectangle rect);
+    std::shared_ptr<TextLayout const> layout_text(std::string_view text);
+    std::shared_ptr<TextLayout const> shape_text(std::string_view text);
     Clr clr_create(char const *clrname) const;
     Color nameToColor(ColorName const &name) const;
 };
@@ -29,12 +29,15 @@
 #include "log.hpp"
 #include "mapping.hpp"
 #include "proc.hpp"
+#include "props.hpp"
+#include "status.hpp"
 #include "strerror.hpp"
 #include "util.hpp"
 #include "variant_utils.hpp"
 #include "winpicker.hpp"
 #include "xidptr.hpp"
 #include "xinerama.hpp"
+#include "xsync.hpp"
 
 #include <fcntl.h>
 #include <project/config.hpp>
@@ -60,9 +63,13 @@
 #include <cstdlib>
 #include <cstring>
 #include <format>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <print>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
 #ifdef ASOUND
@@ -107,33 +114,45 @@ enum {
     NetWMWindowType,
     NetWMWindowTypeDialog,
     NetClientList,
+    NetClientListStacking,
     NetWMIcon,
     NetOpacity,
     NetBypassComp,
     NetOpaqueRegion,
+    NetWMSyncRequest,
+    NetWMSyncRequestCounter,
     NetLast
 }; /* EWMH atoms */
 
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMChangeState, WMLast }; /* default atoms */
 
+enum class DragKind { move, resize }; /* what movemouse and resizemouse do with the pointer motion */
+
 #define PROGRESS_FADE 0, 0, 0
 
 
 /* function declarations */
 
 static void arrange(MonitorRef const &m);
+static void applydrag();
+static bool applystacking(MonitorRef const &m);
 static void arrangemon(MonitorRef const &m);
 static void attach(Client *c);
 static void attachaside(Client *c);
 static void attachstack(Client *c);
 static int avgheight();
+static void begindrag(DragKind kind, Client *c, int x, int y);
 static void buttonpress(XEvent *e);
 static void checkotherwm();
 static void cleanup();
 static void cleanupmon(MonitorRef const &mon);
+static void clientlistadd(Window w);
+static void clientlistremove(Window w);
 static void clientmessage(XEvent *e);
+static void committransaction();
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
+static bool configurewindow(Client *c, Rect<int> const &from, int from_bw, bool offscreen);
 static MonitorRef createmon();
 static void destroynotify(XEvent *e);
 /// Remove client `c` from the list of clients on the monitor `c` is on
@@ -142,6 +161,8 @@ static void detachstack(Client *c);
 static MonitorRef dirtomon(int dir);
 static void drawbar(MonitorRef const &m);
 static void drawbars();
+static void dragmotion(XEvent *e);
+static void dragrelease(XEvent *e);
 static void drawprogress(unsigned long long total, unsigned long long current, Color const *color);
 static Client *ensureUnattached(Client *c);
 static void enqueue(Client *c);
@@ -155,25 +176,36 @@ static int getrootptr(int *x, int *y);
 static long getstate(Window w);
 static bool gettextprop(Window w, Atom atom, char *text, std::size_t size);
 static void grabkeys();
+static void ignorecrossings();
 static void iconifyclient(Client *c);
 static void installEventHandlers();
 static bool isdescprocess(pid_t p, pid_t c);
 static void keypress(XEvent *e);
+static void logpixmapbytes();
 static void manage(Window w, XWindowAttributes *wa);
 static void mappingnotify(XEvent *e);
 static void maprequest(XEvent *e);
 static void motionnotify(XEvent *e);
 static Client *nexttagged(Client *c);
 static Client *nexttiled(Client *c);
+static Client *occludingclient(MonitorRef const &m);
 static void handle_notifyself_fade_anim(FadeBarEvent);
 static void pop(Client *c);
 static void propertynotify(XEvent *e);
 static MonitorRef recttomon(Rect<int> rect);
 static void restack(MonitorRef const &m);
 static void scan();
+static void screenchangenotify(XEvent *e);
 static void sendmon(Client *c, MonitorRef const &m);
+static void sendsyncrequest(Client *c);
 static void setup();
+static bool setupsync(Client *c);
+static void setoccluded(Client *c, bool occluded);
+static void setparked(Client *c, bool parked);
 static void showhide(Client *c);
+static void stopdrag();
+static void syncalarmnotify(XEvent *e);
+static std::size_t tiledcapacity(MonitorRef const &m);
 static Client *swallowingclient(Window w);
 static Client *termforwin(Client const *w);
 static double timespecdiff(const struct timespec *a, const struct timespec *b);
@@ -183,7 +215,9 @@ static void unmapnotify(XEvent *e);
 static void updatebarpos(MonitorRef const &m);
 static void updatebars();
 static void updateclientlist();
-static bool updategeom();
+static void updatelazyprops();
+static std::vector<MonitorRef> updategeom();
+static void updatemonitors();
 static void updatenumlockmask();
 static void updatestatus();
 
@@ -204,12 +238,23 @@ static int xerrorstart(Display *dpy, XErrorEvent *ee);
 constexpr auto TAGMASK = (1uz << tag_symbols.size()) - 1uz;
 constexpr auto BUTTONMASK = toUnsigned(ButtonPressMask) | toUnsigned(ButtonReleaseMask);
 constexpr auto MOUSEMASK = BUTTONMASK | toUnsigned(PointerMotionMask);
+constexpr long CLIENTMASK = EnterWindowMask | FocusChangeMask | PropertyChangeMask | StructureNotifyMask;
 constexpr auto cfact_min = 0.25f;
 constexpr auto cfact_max = 4.0f;
 constexpr auto mfact_min = 0.05f;
 constexpr auto mfact_max = 0.95f;
 static constexpr ut::StaticString broken = "broken";
-static char stext[256];
+static char stext[4096]; /* status lines with many escapes can get long, see StatusText */
+static StatusText status_text;
+
+/* status segments resolved to colors and measured, redone only when the status text changes */
+struct StatusSegmentStyle {
+    Color color;
+    unsigned int width;
+};
+
+static std::vector<StatusSegmentStyle> status_styles;
+static unsigned int status_width;
 static int screen;
 static int sw, sh;                                                   /* X display screen geometry width, height */
 static int bar_height, sel_bar_name_x = -1, sel_bar_name_width = -1; /* bar geometry */
@@ -230,9 +275,123 @@ static volc_t *volc;
 static xcb_connection_t *xcon;
 static std::filesystem::path log_dir;
 static std::unique_ptr<EventLoop> loop = nullptr;
+static PropWriter propwriter;
 static unsigned int borderpx; /* border pixel of windows */
+
+/* While a transaction is open, window changes made by arrange are only recorded. When the outermost TransactionScope
+ * ends they are sent in one go: first the visible windows are placed and restacked, then the hidden ones are moved
+ * away, so the server never paints a half switched tag. */
+struct Transaction {
+    struct Change {
+        Client *c;
+        /* geometry and border the window had on the server before the transaction, from_bw < 0 if unknown */
+        Rect<int> from;
+        int from_bw;
+        /* whether the window ends up off-screen */
+        bool offscreen;
+    };
+
+    std::vector<Change> changes;
+    std::unordered_map<Client *, std::size_t> index;
+    std::vector<MonitorRef> restack;
+    unsigned depth = 0;
+
+    /* The change for `c`, `from` and `from_bw` are only used the first time it is touched */
+    Change &touch(Client *c, Rect<int> const &from, int from_bw) {
+        auto [it, inserted] = index.try_emplace(c, changes.size());
+        if (inserted) changes.push_back({.c = c, .from = from, .from_bw = from_bw, .offscreen = c->offscreen});
+        return changes[it->second];
+    }
+};
+
+static Transaction transaction;
+
+struct TransactionScope {
+    TransactionScope() {
+        transaction.depth++;
+    }
+
+    ~TransactionScope() {
+        if (--transaction.depth == 0) committransaction();
+    }
+
+    TransactionScope(TransactionScope const &) = delete;
+    TransactionScope &operator=(TransactionScope const &) = delete;
+};
+
+/* managed windows in the order they were mapped, written out (with the stacking order) by updateclientlist */
+static std::vector<Window> client_list;
+static bool client_list_dirty = false;
+static bool stacking_dirty = false;
+/* some client has a title or WM hints which were not read yet */
+static bool lazy_props_pending = false;
+/* the screen layout changed, applied once per tick by updatemonitors */
+static bool monitors_dirty = false;
+/* the server has XSync, needed for _NET_WM_SYNC_REQUEST */
+static bool sync_available = false;
+/* bumped whenever a client's size hints may have changed, invalidates every cached Arrangement */
+static std::uint64_t hints_epoch = 0;
+/* crossing events with a serial up to this one were caused by dwm moving windows, see ignorecrossings */
+static unsigned long crossing_mark = 0;
+
+/* An interactive move or resize. Instead of running its own event loop until the button is released, movemouse and
+ * resizemouse swap in the motion and button handlers below, so everything else is handled as usual meanwhile. Only
+ * the latest pointer position is kept and applydrag applies it once per tick. */
+struct Drag {
+    /* the client being dragged, nullptr if there is no drag */
+    Client *c = nullptr;
+    DragKind kind = DragKind::move;
+    /* the client answers _NET_WM_SYNC_REQUEST, a resize waits for it to redraw before sending the next size */
+    bool sync = false;
+    /* client geometry and pointer position when the drag started */
+    Rect<int> start {};
+    int x = 0;
+    int y = 0;
+    /* pointer position not applied yet */
+    std::optional<std::pair<int, int>> motion;
+    /* handlers the drag replaced, put back by stopdrag */
+    std::function<void(XEvent *)> prev_motion;
+    std::function<void(XEvent *)> prev_press;
+    std::function<void(XEvent *)> prev_release;
+};
+
+static Drag drag;
 static unsigned int gappx;    /* gaps between windows */
 static unsigned int snap;     /* snap pixel */
+/* tag symbols never change, so their widths are measured once in setup() */
+static std::array<unsigned int, tag_symbols.size()> tag_widths;
+
+/* Result of the last arrange of a tag, reused (e.g. when switching back to the tag) as long as nothing the layout
+ * depends on has changed */
+struct Arrangement {
+    struct Input {
+        Client *c;
+        float cfact;
+        int bw;
+        bool operator==(Input const &) const = default;
+    };
+
+    struct Placement {
+        Rect<int> size;
+        int bw;
+    };
+
+    Layout const *layout = nullptr;
+    Rect<int> area {};
+    float mfact = 0;
+    int nmaster = 0;
+    std::size_t visible = 0;
+    std::uint64_t hints_epoch = 0;
+    std::vector<Input> inputs;
+    /// Selected client swapped into the last slot in place of a parked one
+    Client *rotated = nullptr;
+    /// The only client laid out when the others are occluded, see occludingclient
+    Client *top = nullptr;
+    /// Only for the clients which were not parked
+    std::vector<Placement> placements;
+    std::string symbol;
+    bool valid = false;
+};
 
 struct Pertag {
     unsigned int curtag, prevtag;                                             /* current and previous tag */
@@ -241,6 +400,7 @@ struct Pertag {
     std::array<unsigned int, tag_symbols.size() + 1> sellts;                  /* selected layouts */
     std::array<std::array<Layout const *, 2>, tag_symbols.size() + 1> ltidxs; /* matrix of tags and layouts indexes  */
     std::array<bool, tag_symbols.size() + 1> showbars;                        /* display bar for the current tag */
+    std::array<Arrangement, tag_symbols.size() + 1> arrangements;             /* last layout result per tag */
 };
 
 static_assert(tag_symbols.size() <= std::numeric_limits<unsigned int>::digits - 1,
@@ -362,7 +522,95 @@ bool Client::applysizehints(Rect<int> *new_size, bool interact) {
     return new_size->x != size.x || new_size->y != size.y || new_size->w != size.w || new_size->h != size.h;
 }
 
+/* Move or resize the dragged client to the latest pointer position, see Drag */
+void applydrag() {
+    if (!drag.c || !drag.motion) return;
+    if (drag.sync && drag.c->syncwaiting) {
+        /* the motion is kept until the client has drawn the last size, syncalarmnotify applies it right away */
+        if (std::chrono::steady_clock::now() - drag.c->syncsent < std::chrono::milliseconds {sync_timeout_ms}) return;
+        lg::debug("{} did not answer a sync request in time, not waiting for it anymore", drag.c->name.view());
+        drag.sync = false;
+    }
+    auto const [px, py] = *std::exchange(drag.motion, std::nullopt);
+    Client *c = drag.c;
+    /* the selection was changed with the keyboard, togglefloating would act on the wrong client */
+    if (c != selmon->sel) return;
+
+    if (drag.kind == DragKind::move) {
+        int nx = drag.start.x + (px - drag.x);
+        int ny = drag.start.y + (py - drag.y);
+        if (std::cmp_less(abs(selmon->window_size.x - nx), snap)) {
+            nx = selmon->window_size.x;
+        } else if (((unsigned)(selmon->window_size.x + selmon->window_size.w) - ((unsigned)nx + WIDTH(c))) < snap) {
+            nx = (int)((unsigned)(selmon->window_size.x + selmon->window_size.w) - WIDTH(c));
+        }
+        if (std::cmp_less(abs(selmon->window_size.y - ny), snap)) {
+            ny = selmon->window_size.y;
+        } else if (((unsigned)(selmon->window_size.y + selmon->window_size.h) - ((unsigned)ny + HEIGHT(c))) < snap) {
+            ny = (int)((unsigned)(selmon->window_size.y + selmon->window_size.h) - HEIGHT(c));
+        }
+        if (!c->props.isfloating && selmon->lt[selmon->sellt]->arrange
+            && (std::cmp_greater(abs(nx - c->size.x), snap) || std::cmp_greater(abs(ny - c->size.y), snap))) {
+            togglefloating();
+        }
+        if (!selmon->lt[selmon->sellt]->arrange || c->props.isfloating) {
+            c->resize({nx, ny, c->size.w, c->size.h}, true);
+        }
+    } else {
+        int nw = std::max(px - drag.start.x - (2 * c->bw) + 1, 1);
+        int nh = std::max(py - drag.start.y - (2 * c->bw) + 1, 1);
+        auto mon_ptr = c->getMon();
+        if (mon_ptr->window_size.x + nw >= selmon->window_size.x
+            && mon_ptr->window_size.x + nw <= selmon->window_size.x + selmon->window_size.w
+            && mon_ptr->window_size.y + nh >= selmon->window_size.y
+            && mon_ptr->window_size.y + nh <= selmon->window_size.y + selmon->window_size.h) {
+            if (!c->props.isfloating && selmon->lt[selmon->sellt]->arrange
+                && (std::cmp_greater(abs(nw - c->size.w), snap) || std::cmp_greater(abs(nh - c->size.h), snap))) {
+                togglefloating();
+            }
+        }
+        if (!selmon->lt[selmon->sellt]->arrange || c->props.isfloating) {
+            Rect<int> size {c->size.x, c->size.y, nw, nh};
+            /* only ask for a sync when there will be a ConfigureNotify to answer */
+            if (c->applysizehints(&size, true)) {
+                if (drag.sync) sendsyncrequest(c);
+                c->resizeclient(size);
+            }
+        }
+    }
+}
+
+/* Raise the selected client if it is floating and put the tiled ones under the bar, returns true if anything changed */
+bool applystacking(MonitorRef const &m) {
+    bool changed = false;
+
+    if (!m->sel) {
+        return false;
+    }
+    if ((m->sel->props.isfloating || !m->lt[m->sellt]->arrange) && m->raised != m->sel->win) {
+        XRaiseWindow(dpy, m->sel->win);
+        m->raised = m->sel->win;
+        changed = true;
+    }
+    if (m->lt[m->sellt]->arrange) {
+        /* reused between restacks */
+        static std::vector<Window> order;
+        order.clear();
+        order.push_back(m->barwin);
+        for (Client *c = m->stack; c; c = c->snext)
+            if (!c->props.isfloating && c->isVisible()) order.push_back(c->win);
+        if (order.size() > 1 && order != m->stacking) {
+            XRestackWindows(dpy, order.data(), static_cast<int>(order.size()));
+            m->stacking.assign(order.begin(), order.end());
+            changed = true;
+        }
+    }
+    if (changed) stacking_dirty = true;
+    return changed;
+}
+
 void arrange(MonitorRef const &m) {
+    TransactionScope tx;
     if (m) {
         showhide(m->stack);
     } else {
@@ -381,7 +629,100 @@ void arrange(MonitorRef const &m) {
 void arrangemon(MonitorRef const &m) {
     strncpy(m->layoutSymbol.data(), m->lt[m->sellt]->symbol, m->layoutSymbol.max_size() - 1);
     if (m->lt[m->sellt]->arrange) {
-        m->lt[m->sellt]->arrange(m);
+        /* reused between arranges, layouts never arrange recursively */
+        static std::vector<Client *> tiled;
+        static std::vector<Arrangement::Input> inputs;
+        std::size_t visible = 0;
+        tiled.clear();
+        inputs.clear();
+        for (Client *c = m->clients; c; c = c->next) {
+            if (!c->isVisible()) continue;
+            visible++;
+            if (c->props.isfloating) {
+                setoccluded(c, false);
+                setparked(c, false);
+                continue;
+            }
+            tiled.push_back(c);
+            inputs.push_back({.c = c, .cfact = c->cfact, .bw = c->bw});
+        }
+        /* clients past what the layout has room for are parked off-screen, the selected one always gets a slot */
+        auto placed = std::min(tiled.size(), tiledcapacity(m));
+        Client *rotated = nullptr;
+        if (placed < tiled.size()) {
+            auto sel = std::find(tiled.begin() + (std::ptrdiff_t)placed, tiled.end(), m->sel);
+            if (sel != tiled.end()) {
+                rotated = m->sel;
+                std::iter_swap(tiled.begin() + (std::ptrdiff_t)placed - 1, sel);
+            }
+        }
+        /* covered clients are not laid out at all, they get their geometry once they are uncovered */
+        Client *top = occludingclient(m);
+        if (top) {
+            auto it = std::find(tiled.begin(), tiled.end(), top);
+            placed = it != tiled.end();
+            if (placed) std::iter_swap(tiled.begin(), it);
+        }
+        for (std::size_t i = 0; i < tiled.size(); i++) {
+            auto *c = tiled[i];
+            if (i >= placed && top && hide_occluded == Occluded::iconify) {
+                /* unmap first, so that moving it back is not visible */
+                setoccluded(c, true);
+                setparked(c, false);
+            } else {
+                setparked(c, i >= placed);
+                setoccluded(c, false);
+            }
+        }
+        /* counted after `top` changed `placed`, iconified clients are not parked */
+        auto const overflow = static_cast<std::size_t>(rng::count_if(tiled, [](Client const *c) { return c->parked; }));
+        m->gapless = m->lt[m->sellt]->arrange == monocle || placed == 1;
+
+        auto &cached = m->pertag->arrangements[m->pertag->curtag];
+        bool reuse = cached.valid && cached.layout == m->lt[m->sellt] && cached.area == m->window_size
+                  && cached.mfact == m->mfact && cached.nmaster == m->nmaster && cached.visible == visible
+                  && cached.hints_epoch == hints_epoch && cached.inputs == inputs && cached.rotated == rotated
+                  && cached.top == top;
+
+        if (reuse) {
+            strncpy(m->layoutSymbol.data(), cached.symbol.c_str(), m->layoutSymbol.max_size() - 1);
+            for (std::size_t i = 0; i < placed; i++) {
+                auto *c = tiled[i];
+                auto const &placement = cached.placements[i];
+                if (c->size == placement.size && c->winbw == placement.bw) continue;
+                transaction.touch(c, c->size, c->winbw);
+                c->old_size = c->size;
+                c->size = placement.size;
+                c->winbw = placement.bw;
+            }
+        } else {
+            m->lt[m->sellt]->arrange(m, {.clients = std::span(tiled).first(placed), .gapless = m->gapless});
+            if (overflow) {
+                auto len = strlen(m->layoutSymbol.data());
+                snprintf(m->layoutSymbol.data() + len, m->layoutSymbol.max_size() - len, "+%zu", overflow);
+            }
+            cached.layout = m->lt[m->sellt];
+            cached.area = m->window_size;
+            cached.mfact = m->mfact;
+            cached.nmaster = m->nmaster;
+            cached.visible = visible;
+            cached.hints_epoch = hints_epoch;
+            cached.inputs.assign(inputs.begin(), inputs.end());
+            cached.rotated = rotated;
+            cached.top = top;
+            cached.placements.clear();
+            for (auto const *c : std::span(tiled).first(placed))
+                cached.placements.push_back({.size = c->size, .bw = c->winbw});
+            cached.symbol = m->layoutSymbol.data();
+            cached.valid = true;
+        }
+    } else {
+        /* floating layout, everything fits */
+        for (Client *c = m->clients; c; c = c->next) {
+            if (!c->isVisible()) continue;
+            setoccluded(c, false);
+            setparked(c, false);
+        }
     }
 }
 
@@ -434,15 +775,22 @@ void swallow(Client *p, Client *c) {
     Window w = p->win;
     p->win = c->win;
     c->win = w;
+    /* the window still has the border it had as c */
+    p->winbw = -1;
     p->updatetitle();
     arrange(p->getMon());
     XMoveResizeWindow(dpy, p->win, p->size.x, p->size.y, static_cast<unsigned>(p->size.w), static_cast<unsigned>(p->size.h));
+    p->offscreen = false;
     p->configure();
-    updateclientlist();
+    /* the terminal's window is withdrawn */
+    clientlistremove(c->win);
 }
 
 void unswallow(Client *c) {
+    clientlistremove(c->win);
+    clientlistadd(c->swallowing->win);
     c->win = c->swallowing->win;
+    c->winbw = -1;
 
     delete ensureUnattached(c->swallowing);
     c->swallowing = nullptr;
@@ -452,6 +800,7 @@ void unswallow(Client *c) {
     arrange(c->getMon());
     XMapWindow(dpy, c->win);
     XMoveResizeWindow(dpy, c->win, c->size.x, c->size.y, static_cast<unsigned>(c->size.w), static_cast<unsigned>(c->size.h));
+    c->offscreen = false;
     c->configure();
     c->setclientstate(NormalState);
 }
@@ -505,9 +854,21 @@ void dmenu_run() {
     spawn(cmd.data());
 }
 
+/* Start dragging `c`, the pointer has to be grabbed already. `x` and `y` are where the pointer is */
+void begindrag(DragKind kind, Client *c, int x, int y) {
+    drag.c = c;
+    drag.kind = kind;
+    drag.start = c->size;
+    drag.x = x;
+    drag.y = y;
+    drag.motion = std::nullopt;
+    drag.prev_motion = loop->on<MotionNotify>(dragmotion);
+    /* other buttons do nothing until this one is released */
+    drag.prev_press = loop->on<ButtonPress>([](XEvent *) { });
+    drag.prev_release = loop->on<ButtonRelease>(dragrelease);
+}
+
 void buttonpress(XEvent *e) {
-    unsigned int i;
-    unsigned int x;
     unsigned int click;
     Arg arg = {0};
     MonitorRef m;
@@ -521,19 +882,10 @@ void buttonpress(XEvent *e) {
         focus(nullptr);
     }
     if (ev->window == selmon->barwin) {
-        i = x = 0;
-        do {
-            x += TEXTW(tag_symbols[i]);
-        } while (std::cmp_greater_equal(ev->x, x) && ++i < tag_symbols.size());
-        if (i < tag_symbols.size()) {
-            click = ClkTagBar;
-            arg = 1u << i;
-        } else if ((unsigned)ev->x < x + TEXTW(selmon->layoutSymbol.data())) {
-            click = ClkLtSymbol;
-        } else if (ev->x > selmon->window_size.w - (int)TEXTW(stext)) {
-            click = ClkStatusText;
-        } else {
-            click = ClkWinTitle;
+        /* the regions are from the last drawbar, which focusing the monitor above redid if necessary */
+        if (auto hit = selmon->bar_hits.find(ev->x)) {
+            click = hit->click;
+            if (click == ClkTagBar) arg = 1u << hit->tag;
         }
     } else if (auto *c = wintoclient(ev->window)) {
         focus(c);
@@ -580,7 +932,10 @@ void cleanup() {
     delete drw;
     XSync(dpy, False);
     XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
-    XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+    propwriter.remove(root, netatom[NetActiveWindow]);
+    /* the event loop is not running anymore */
+    updateclientlist();
+    propwriter.flush(dpy);
 #ifdef ASOUND
     volc_deinit(volc);
 #endif /* ASOUND */
@@ -589,10 +944,23 @@ void cleanup() {
 void cleanupmon(MonitorRef const &mon) {
     // TODO(dk949): this needs to go in the Monitor destructor!
     XUnmapWindow(dpy, mon->barwin);
+    drw->release(mon->barwin);
     XDestroyWindow(dpy, mon->barwin);
     delete mon->pertag;
 }
 
+void clientlistadd(Window w) {
+    client_list.push_back(w);
+    client_list_dirty = stacking_dirty = true;
+}
+
+void clientlistremove(Window w) {
+    if (auto it = rng::find(client_list, w); it != client_list.end()) {
+        client_list.erase(it);
+        client_list_dirty = stacking_dirty = true;
+    }
+}
+
 void clientmessage(XEvent *e) {
     XClientMessageEvent *cme = &e->xclient;
 
@@ -639,32 +1007,13 @@ void Client::configure() const {
 void configurenotify(XEvent *e) {
     XConfigureEvent *ev = &e->xconfigure;
 
-    // TODO(dk949): Figure out what this means??
-    /* TODO: updategeom handling sucks, needs to be simplified */
+    /* only the root window changing size matters, i.e. the screen layout changed */
     if (ev->window != root) return;
 
-    bool dirty = sw != ev->width || sh != ev->height;
+    screenChanged(e);
     sw = ev->width;
     sh = ev->height;
-    if (updategeom() || dirty) {
-        drw->resize((unsigned)sw, (unsigned)bar_height);
-        updatebars();
-        for (auto const &m : mons) {
-            for (Client *c = m->clients; c; c = c->next) {
-                if (c->props.isfullscreen == FullScreen::on) {
-                    c->resizeclient(m->monitor_size);
-                }
-            }
-            XMoveResizeWindow(dpy,
-                m->barwin,
-                m->window_size.x,
-                m->bar_y,
-                static_cast<unsigned>(m->window_size.w),
-                static_cast<unsigned>(bar_height));
-        }
-        focus(nullptr);
-        arrange(nullptr);
-    }
+    monitors_dirty = true;
 }
 
 void configurerequest(XEvent *e) {
@@ -724,7 +1073,61 @@ void configurerequest(XEvent *e) {
         wc.stack_mode = ev->detail;
         XConfigureWindow(dpy, ev->window, static_cast<unsigned int>(ev->value_mask), &wc);
     }
-    XSync(dpy, False);
+}
+
+/* Send the client's geometry to the server if it differs from `from` and `from_bw` or the window has to be moved on or
+ * off the screen, returns true if it did */
+bool configurewindow(Client *c, Rect<int> const &from, int from_bw, bool offscreen) {
+    XWindowChanges wc = {
+        .x = offscreen ? static_cast<int>(WIDTH(c) * -2u) : c->size.x,
+        .y = c->size.y,
+        .width = c->size.w,
+        .height = c->size.h,
+        .border_width = c->winbw,
+        .sibling = None,
+        .stack_mode = 0,
+    };
+    unsigned int mask = 0;
+    if (from_bw < 0) {
+        mask = CWX | CWY | CWWidth | CWHeight | CWBorderWidth;
+    } else {
+        if (offscreen != c->offscreen || (!offscreen && c->size.x != from.x)) mask |= CWX;
+        if (offscreen != c->offscreen || c->size.y != from.y) mask |= CWY;
+        if (c->size.w != from.w) mask |= CWWidth;
+        if (c->size.h != from.h) mask |= CWHeight;
+        if (c->winbw != from_bw) mask |= CWBorderWidth;
+    }
+    if (!mask) return false;
+
+    XConfigureWindow(dpy, c->win, mask, &wc);
+    c->offscreen = offscreen;
+    if (!offscreen) c->configure();
+    return true;
+}
+
+void committransaction() {
+    std::size_t shown = 0;
+    std::size_t hidden = 0;
+    for (auto const &change : transaction.changes)
+        if (!change.offscreen && configurewindow(change.c, change.from, change.from_bw, false)) shown++;
+    bool restacked = false;
+    for (auto const &m : transaction.restack)
+        restacked |= applystacking(m);
+    /* hide clients bottom up */
+    for (auto const &change : transaction.changes | vws::reverse)
+        if (change.offscreen && configurewindow(change.c, change.from, change.from_bw, true)) hidden++;
+
+    ignorecrossings();
+    XFlush(dpy);
+    if constexpr (dwm::log_events)
+        lg::debug("transaction: {} configured, {} hidden, {} unchanged, {}restacked",
+            shown,
+            hidden,
+            transaction.changes.size() - shown - hidden,
+            restacked ? "" : "not ");
+    transaction.changes.clear();
+    transaction.index.clear();
+    transaction.restack.clear();
 }
 
 MonitorRef createmon() {
@@ -806,6 +1209,26 @@ MonitorRef dirtomon(int dir) {
 
 // TODO(dk949): handle the case where the tags overlap with status
 //              (common if monitor is vertical)
+void dragmotion(XEvent *e) {
+    drag.motion = std::pair {e->xmotion.x, e->xmotion.y};
+}
+
+void dragrelease(XEvent *) {
+    /* the final size is applied whether or not the client has caught up */
+    drag.sync = false;
+    applydrag();
+    Client *c = drag.c;
+    bool const resizing = drag.kind == DragKind::resize;
+    if (resizing) XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->size.w + c->bw - 1, c->size.h + c->bw - 1);
+    stopdrag();
+    if (resizing) ignorecrossings();
+    if (auto m = recttomon(c->size); m != selmon) {
+        sendmon(c, m);
+        selmon = m;
+        focus(nullptr);
+    }
+}
+
 void drawbar(MonitorRef const &m) {
     int x;
     int w;
@@ -818,11 +1241,30 @@ void drawbar(MonitorRef const &m) {
 
     if (!m->showbar) return;
 
+    auto first_request = NextRequest(dpy);
+    m->bar_hits.clear();
+    if (drw->target(m->barwin, (unsigned)m->window_size.w, (unsigned)bar_height)) m->bar.invalidate();
+    m->bar.begin();
+
+    /* Segments are only redrawn if their key changed, the back buffer still has the rest. Segment indices are:
+     * status, one per tag, layout symbol, title. */
+    std::size_t seg = 0;
+
     /* draw status first so it can be overdrawn by tags later */
-    if (m == selmon) {                                          /* status is only drawn on selected monitor */
-        drw->setColor(&drw->scheme().status);
-        text_width = (int)(TEXTW(stext) - (unsigned)lrpad + 2); /* 2px right padding */
-        drw->draw_text(m->window_size.w - text_width, 0, (unsigned)text_width, (unsigned)bar_height, 0, stext, false);
+    if (m == selmon) {                        /* status is only drawn on selected monitor */
+        text_width = (int)status_width + 2; /* 2px right padding */
+    }
+    if (m->bar.update(seg++, m->window_size.w - text_width, text_width, segmentKey(text_width, status_text.hash()))
+        && text_width) {
+        auto segments = status_text.segments();
+        x = m->window_size.w - text_width;
+        for (std::size_t s = 0; s < segments.size(); s++) {
+            /* the last segment gets the padding */
+            w = s + 1 == segments.size() ? m->window_size.w - x : (int)status_styles[s].width;
+            drw->setColor(&status_styles[s].color);
+            drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, 0, segments[s].text.c_str(), false);
+            x += w;
+        }
     }
 
     for (Client *c = m->clients; c; c = c->next) {
@@ -833,35 +1275,39 @@ void drawbar(MonitorRef const &m) {
     }
     x = 0;
     for (i = 0; i < tag_symbols.size(); i++) {
-        w = (int)TEXTW(tag_symbols[i]);
-        if (m->tagset[m->seltags] & 1 << i)
-            drw->setColor(&drw->scheme().tags_sel);
-        else
-            drw->setColor(&drw->scheme().tags_norm);
-
-        drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, (unsigned)(lrpad / 2), tag_symbols[i], (urg & 1 << i) != 0u);
-        if (occ & 1 << i) {
-            drw->draw_rect(x + boxs,
-                boxs,
-                (unsigned)boxw,
-                (unsigned)boxw,
-                m == selmon && (selmon->sel != nullptr) && ((selmon->sel->tags & 1 << i) != 0u),
-                ((int)(urg & 1 << i)) != 0);
+        w = (int)tag_widths[i];
+        bool selected = (m->tagset[m->seltags] & 1 << i) != 0u;
+        bool occupied = (occ & 1 << i) != 0u;
+        bool urgent = (urg & 1 << i) != 0u;
+        bool has_sel = m == selmon && (selmon->sel != nullptr) && ((selmon->sel->tags & 1 << i) != 0u);
+        if (m->bar.update(seg++, x, w, segmentKey(x, w, selected, occupied, urgent, has_sel))) {
+            drw->setColor(selected ? &drw->scheme().tags_sel : &drw->scheme().tags_norm);
+            drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, (unsigned)(lrpad / 2), tag_symbols[i], urgent);
+            if (occupied) drw->draw_rect(x + boxs, boxs, (unsigned)boxw, (unsigned)boxw, has_sel, urgent);
         }
         x += w;
+        m->bar_hits.add(x, ClkTagBar, i);
     }
     w = (int)TEXTW(m->layoutSymbol.data());
-    drw->setColor(&drw->scheme().tags_norm);
-    x = drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, (unsigned)(lrpad / 2), m->layoutSymbol.data(), false);
+    if (m->bar.update(seg++, x, w, segmentKey(x, w, m->layoutSymbol.data()))) {
+        drw->setColor(&drw->scheme().tags_norm);
+        drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, (unsigned)(lrpad / 2), m->layoutSymbol.data(), false);
+    }
+    x += w;
+    m->bar_hits.add(x, ClkLtSymbol);
+    m->bar_hits.add(m->window_size.w - text_width, ClkWinTitle);
+    m->bar_hits.add(m->window_size.w, ClkStatusText);
 
     if ((w = m->window_size.w - text_width - x) > bar_height) {
         if (m->sel) {
-            drw->setColor(m == selmon ? &drw->scheme().info_sel : &drw->scheme().info_norm);
-            drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, (unsigned)(lrpad / 2), m->sel->name.data(), false);
-            if (m->sel->props.isfloating) {
-                drw->draw_rect(x + boxs, boxs, (unsigned)boxw, (unsigned)boxw, m->sel->props.isfixed, false);
+            bool floating = m->sel->props.isfloating;
+            bool fixed = m->sel->props.isfixed;
+            if (m->bar.update(seg, x, w, segmentKey(x, w, m == selmon, floating, fixed, m->sel->name.data()))) {
+                drw->setColor(m == selmon ? &drw->scheme().info_sel : &drw->scheme().info_norm);
+                drw->draw_text(x, 0, (unsigned)w, (unsigned)bar_height, (unsigned)(lrpad / 2), m->sel->name.data(), false);
+                if (floating) drw->draw_rect(x + boxs, boxs, (unsigned)boxw, (unsigned)boxw, fixed, false);
             }
-        } else {
+        } else if (m->bar.update(seg, x, w, segmentKey(x, w))) {
             drw->setColor(&drw->scheme().info_norm);
             drw->draw_rect(x, 0, (unsigned)w, (unsigned)bar_height, /*filled*/ true, /*invert*/ true);
         }
@@ -870,8 +1316,9 @@ void drawbar(MonitorRef const &m) {
         sel_bar_name_x = x;
         sel_bar_name_width = w;
     }
-    drw->map(m->barwin, 0, 0, (unsigned)m->window_size.w, (unsigned)bar_height);
+    if (auto damage = m->bar.takeDamage()) drw->map(m->barwin, damage->x, 0, (unsigned)damage->w, (unsigned)bar_height);
     drawprogress(PROGRESS_FADE);
+    if constexpr (dwm::log_events) lg::debug("drawbar({}): {} requests", m->num, NextRequest(dpy) - first_request);
 }
 
 void drawbars() {
@@ -907,6 +1354,8 @@ void drawprogress(unsigned long long t, unsigned long long c, Color const *color
         int h = bar_height; /*progress rectangle*/
         int fg = 0;
         int bg = 1;
+        if (drw->target(selmon->barwin, (unsigned)selmon->window_size.w, (unsigned)bar_height))
+            selmon->bar.invalidate();
         drw->setColor(cscheme);
 
         drw->draw_rect(x, y, (unsigned)w, (unsigned)h, true, bg != 0);
@@ -918,6 +1367,8 @@ void drawprogress(unsigned long long t, unsigned long long c, Color const *color
             fg != 0);
 
         drw->map(selmon->barwin, x, y, (unsigned)w, (unsigned)h);
+        /* the title segment has to be redrawn once the progress bar is gone */
+        selmon->bar.invalidate(x, w);
         loop->push(FadeBarEvent());
     }
 }
@@ -951,6 +1402,11 @@ void enternotify(XEvent *e) {
     Client *c;
     XCrossingEvent *ev = &e->xcrossing;
 
+    /* the window under the pointer changed because dwm moved or restacked windows, not because the pointer moved */
+    if (static_cast<long>(ev->serial - crossing_mark) <= 0) {
+        if constexpr (dwm::log_events) lg::debug("enternotify: ignoring crossing with serial {}", ev->serial);
+        return;
+    }
     if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) && ev->window != root) {
         return;
     }
@@ -970,6 +1426,8 @@ void expose(XEvent *e) {
     XExposeEvent *ev = &e->xexpose;
 
     if (ev->count == 0 && (m = wintomon(ev->window))) {
+        /* the window lost its contents while the back buffer did not change, make drawbar copy all of it */
+        m->bar.invalidate();
         drawbar(m);
     }
 }
@@ -986,16 +1444,24 @@ void focus(Client *c) {
         auto mon_ptr = c->getMon();
         if (mon_ptr != selmon) selmon = mon_ptr;
 
+        /* propertynotify only marks these as changed */
+        if (c->wmhintsdirty) c->updatewmhints();
+        if (c->titledirty) c->updatetitle();
         if (c->props.isurgent == IsUrgent::yes) c->seturgent(IsUrgent::no);
 
         detachstack(c);
         attachstack(c);
+        /* a parked or occluded client is brought back (and rotated into the layout) before it takes focus */
+        if (c->parked || c->occluded) {
+            selmon->sel = c;
+            arrange(selmon);
+        }
         c->grabbuttons(true);
         XSetWindowBorder(dpy, c->win, drw->scheme().sel.border.pixel);
         c->setfocus();
     } else {
         XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
-        XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+        propwriter.remove(root, netatom[NetActiveWindow]);
     }
     selmon->sel = c;
     drawbars();
@@ -1199,18 +1665,17 @@ void iconify() {
     if (!XIconifyWindow(dpy, selmon->sel->win, screen)) lg::debug("Could not iconify {}", selmon->sel->name);
 }
 
-void incnmaster(int arg) {
-    setmaster(std::max(selmon->nmaster + arg, 0));
+void ignorecrossings() {
+    /* nothing has been sent since the last XNoOp */
+    if (NextRequest(dpy) - 2 == crossing_mark) return;
+    crossing_mark = NextRequest(dpy) - 1;
+    /* events carry the serial of the last request the server processed, without a request after the mark a real
+     * crossing that happens before dwm sends anything else would have the marked serial too */
+    XNoOp(dpy);
 }
 
-static int isuniquegeom(std::span<ScreenInfo const> unique, size_t n, ScreenInfo info) {
-    while (n--) {
-        if (unique[n].x_org == info.x_org && unique[n].y_org == info.y_org && unique[n].width == info.width
-            && unique[n].height == info.height) {
-            return 0;
-        }
-    }
-    return 1;
+void incnmaster(int arg) {
+    setmaster(std::max(selmon->nmaster + arg, 0));
 }
 
 void keypress(XEvent *e) {
@@ -1280,37 +1745,32 @@ void manage(Window w, XWindowAttributes *wa) {
 
     c->bw = (int)borderpx;
 
-    wc.border_width = c->bw;
+    wc.border_width = c->winbw = c->bw;
     XConfigureWindow(dpy, w, CWBorderWidth, &wc);
     XSetWindowBorder(dpy, w, drw->scheme().norm.border.pixel);
     c->configure(); /* propagates border_width, if size doesn't change */
     c->updatewindowtype();
     c->updatesizehints();
     c->updatewmhints();
-    XSelectInput(dpy, w, EnterWindowMask | FocusChangeMask | PropertyChangeMask | StructureNotifyMask);
+    XSelectInput(dpy, w, CLIENTMASK);
     c->grabbuttons(false);
     if (!c->props.isfloating) {
         c->props.isfloating = c->props.old_float_state = trans != None || c->props.isfixed;
     }
     if (c->props.isfloating) {
         XRaiseWindow(dpy, c->win);
+        c->getMon()->raised = c->win;
     }
     attachaside(c);
     attachstack(c);
-    XChangeProperty(dpy,
-        root,
-        netatom[NetClientList],
-        XA_WINDOW,
-        32,
-        PropModeAppend,
-        reinterpret_cast<unsigned char const *>(&c->win),
-        1);
+    clientlistadd(c->win);
     XMoveResizeWindow(dpy,
         c->win,
         c->size.x + (2 * sw),
         c->size.y,
         static_cast<unsigned>(c->size.w),
         static_cast<unsigned>(c->size.h)); /* some windows require this */
+    c->offscreen = true;
     c->setclientstate(NormalState);
     if (c->getMon() == selmon && selmon->sel) selmon->sel->unfocus(false);
 
@@ -1344,7 +1804,7 @@ void maprequest(XEvent *e) {
     }
 }
 
-void monocle(MonitorRef const &m) {
+void monocle(MonitorRef const &m, TiledClients const &tiled) {
     unsigned int n = 0;
     Client *c;
 
@@ -1356,13 +1816,13 @@ void monocle(MonitorRef const &m) {
     if (n > 0) { /* override layout symbol */
         snprintf(m->layoutSymbol.data(), m->layoutSymbol.max_size(), "[%d]", n);
     }
-    for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
-        c->resize(
+    for (auto *tc : tiled.clients) {
+        tc->resize(
             {
                 m->window_size.x,
                 m->window_size.y,
-                m->window_size.w - (2 * c->bw),
-                m->window_size.h - (2 * c->bw),
+                m->window_size.w - (2 * tc->bw),
+                m->window_size.h - (2 * tc->bw),
             },
             false);
     }
@@ -1389,78 +1849,26 @@ void motionnotify(XEvent *e) {
 }
 
 void movemouse() {
+    Client *c = selmon->sel;
     int x;
     int y;
-    int ocx;
-    int ocy;
-    int nx;
-    int ny;
-    Client *c;
-    XEvent ev;
-    Time lasttime = 0;
 
-    if (!(c = selmon->sel)) {
+    if (!c || drag.c) {
         return;
     }
     if (c->props.isfullscreen == FullScreen::on) { /* no support moving fullscreen windows by mouse */
         return;
     }
     restack(selmon);
-    ocx = c->size.x;
-    ocy = c->size.y;
     if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync, None, drw->cursors().move(), CurrentTime)
         != GrabSuccess) {
         return;
     }
     if (!getrootptr(&x, &y)) {
+        XUngrabPointer(dpy, CurrentTime);
         return;
     }
-    do {
-        XMaskEvent(dpy, MOUSEMASK | ExposureMask | SubstructureRedirectMask, &ev);
-        switch (ev.type) {
-            // TODO(dk949): make sure these don't actually need special treatment
-            case ButtonRelease:
-            case NoExpose: break;
-            case ConfigureRequest: loop->exec<ConfigureRequest>(&ev); break;
-            case Expose: loop->exec<Expose>(&ev); break;
-            case MapRequest: loop->exec<MapRequest>(&ev); break;
-            case MotionNotify:
-                if ((ev.xmotion.time - lasttime) <= (1000 / 60)) {
-                    continue;
-                }
-                lasttime = ev.xmotion.time;
-
-                nx = ocx + (ev.xmotion.x - x);
-                ny = ocy + (ev.xmotion.y - y);
-                if (std::cmp_less(abs(selmon->window_size.x - nx), snap)) {
-                    nx = selmon->window_size.x;
-                } else if (((unsigned)(selmon->window_size.x + selmon->window_size.w) - ((unsigned)nx + WIDTH(c)))
-                           < snap) {
-                    nx = (int)((unsigned)(selmon->window_size.x + selmon->window_size.w) - WIDTH(c));
-                }
-                if (std::cmp_less(abs(selmon->window_size.y - ny), snap)) {
-                    ny = selmon->window_size.y;
-                } else if (((unsigned)(selmon->window_size.y + selmon->window_size.h) - ((unsigned)ny + HEIGHT(c)))
-                           < snap) {
-                    ny = (int)((unsigned)(selmon->window_size.y + selmon->window_size.h) - HEIGHT(c));
-                }
-                if (!c->props.isfloating && selmon->lt[selmon->sellt]->arrange
-                    && (std::cmp_greater(abs(nx - c->size.x), snap) || std::cmp_greater(abs(ny - c->size.y), snap))) {
-                    togglefloating();
-                }
-                if (!selmon->lt[selmon->sellt]->arrange || c->props.isfloating) {
-                    c->resize({nx, ny, c->size.w, c->size.h}, true);
-                }
-                break;
-            default: lg::warn("Unexpected event type {} in movemouse", ev.type); break;
-        }
-    } while (ev.type != ButtonRelease);
-    XUngrabPointer(dpy, CurrentTime);
-    if (auto m = recttomon(c->size); m != selmon) {
-        sendmon(c, m);
-        selmon = m;
-        focus(nullptr);
-    }
+    begindrag(DragKind::move, c, x, y);
 }
 
 Client *nexttagged(Client *c) {
@@ -1476,6 +1884,15 @@ Client *nexttiled(Client *c) {
     return c;
 }
 
+Client *occludingclient(MonitorRef const &m) {
+    if (hide_occluded == Occluded::keep) return nullptr;
+    if (m->sel && m->sel->isVisible() && m->sel->props.isfullscreen) return m->sel;
+    if (m->lt[m->sellt]->arrange != monocle) return nullptr;
+    for (Client *c = m->stack; c; c = c->snext)
+        if (c->isVisible() && !c->props.isfloating) return c;
+    return nullptr;
+}
+
 void pop(Client *c) {
     detach(c);
     attach(c);
@@ -1501,15 +1918,18 @@ void propertynotify(XEvent *e) {
                     arrange(c->getMon());
                 }
                 break;
-            case XA_WM_NORMAL_HINTS: c->hintsvalid = false; break;
+            case XA_WM_NORMAL_HINTS:
+                c->hintsvalid = false;
+                hints_epoch++;
+                break;
             case XA_WM_HINTS:
-                c->updatewmhints();
-                drawbars();
+                c->wmhintsdirty = true;
+                lazy_props_pending = true;
                 break;
         }
         if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
-            c->updatetitle();
-            if (c == c->getMon()->sel) drawbar(c->getMon());
+            c->titledirty = true;
+            lazy_props_pending = true;
         }
         if (ev->atom == netatom[NetWMWindowType]) {
             c->updatewindowtype();
@@ -1537,26 +1957,22 @@ void Client::resize(Rect<int> new_size, bool interact) {
 }
 
 void Client::resizeclient(Rect<int> new_size) {
-    XWindowChanges wc;
-    unsigned int n;
     unsigned int gapoffset;
     unsigned int gapincr;
-    Client *nbc;
-
-    wc.border_width = bw;
+    auto from = size;
+    auto from_bw = winbw;
 
-    /* Get number of clients for the selected monitor */
-    for (n = 0, nbc = nexttiled(getMon()->clients); nbc; nbc = nexttiled(nbc->next), n++) { }
+    winbw = bw;
 
     /* Do nothing if layout is floating */
     if (props.isfloating || getMon()->lt[getMon()->sellt]->arrange == nullptr) {
         gapincr = gapoffset = 0;
     } else {
         /* Remove border and gap if layout is monocle or only one client */
-        if (getMon()->lt[getMon()->sellt]->arrange == monocle || n == 1) {
+        if (getMon()->gapless) {
             gapoffset = 0;
             gapincr = -2u * borderpx;
-            wc.border_width = 0;
+            winbw = 0;
         } else {
             gapoffset = gappx;
             gapincr = 2 * gappx;
@@ -1564,114 +1980,49 @@ void Client::resizeclient(Rect<int> new_size) {
     }
 
     old_size.x = size.x;
-    size.x = wc.x = (int)((unsigned)new_size.x + gapoffset);
+    size.x = (int)((unsigned)new_size.x + gapoffset);
     old_size.y = size.y;
-    size.y = wc.y = (int)((unsigned)new_size.y + gapoffset);
+    size.y = (int)((unsigned)new_size.y + gapoffset);
     old_size.w = size.w;
-    size.w = wc.width = (int)((unsigned)new_size.w - gapincr);
+    size.w = (int)((unsigned)new_size.w - gapincr);
     old_size.h = size.h;
-    size.h = wc.height = (int)((unsigned)new_size.h - gapincr);
+    size.h = (int)((unsigned)new_size.h - gapincr);
 
-    XConfigureWindow(dpy, win, CWX | CWY | CWWidth | CWHeight | CWBorderWidth, &wc);
-    configure();
-    XSync(dpy, False);
+    if (transaction.depth)
+        transaction.touch(this, from, from_bw);
+    else if (configurewindow(this, from, from_bw, offscreen))
+        XSync(dpy, False);
 }
 
 void resizemouse() {
-    int ocx;
-    int ocy;
-    int nw;
-    int nh;
-    Client *c;
-    XEvent ev;
-    Time lasttime = 0;
+    Client *c = selmon->sel;
 
-    if (!(c = selmon->sel)) {
+    if (!c || drag.c) {
         return;
     }
     if (c->props.isfullscreen == FullScreen::on) { /* no support resizing fullscreen windows by mouse */
         return;
     }
     restack(selmon);
-    ocx = c->size.x;
-    ocy = c->size.y;
     if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync, None, drw->cursors().resize(), CurrentTime)
         != GrabSuccess) {
         return;
     }
     XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->size.w + c->bw - 1, c->size.h + c->bw - 1);
-    do {
-        XMaskEvent(dpy, MOUSEMASK | ExposureMask | SubstructureRedirectMask, &ev);
-        switch (ev.type) {
-            // TODO(dk949): make sure these don't actually need special treatment
-            case ButtonRelease:
-            case NoExpose: break;
-            case ConfigureRequest: loop->exec<ConfigureRequest>(&ev); break;
-            case Expose: loop->exec<Expose>(&ev); break;
-            case MapRequest: loop->exec<MapRequest>(&ev); break;
-            case MotionNotify: {
-                if ((ev.xmotion.time - lasttime) <= (1000 / 60)) {
-                    continue;
-                }
-                lasttime = ev.xmotion.time;
-
-                nw = std::max(ev.xmotion.x - ocx - (2 * c->bw) + 1, 1);
-                nh = std::max(ev.xmotion.y - ocy - (2 * c->bw) + 1, 1);
-                auto mon_ptr = c->getMon();
-                if (mon_ptr->window_size.x + nw >= selmon->window_size.x
-                    && mon_ptr->window_size.x + nw <= selmon->window_size.x + selmon->window_size.w
-                    && mon_ptr->window_size.y + nh >= selmon->window_size.y
-                    && mon_ptr->window_size.y + nh <= selmon->window_size.y + selmon->window_size.h) {
-                    if (!c->props.isfloating && selmon->lt[selmon->sellt]->arrange
-                        && (std::cmp_greater(abs(nw - c->size.w), snap) || std::cmp_greater(abs(nh - c->size.h), snap))) {
-                        togglefloating();
-                    }
-                }
-                if (!selmon->lt[selmon->sellt]->arrange || c->props.isfloating) {
-                    c->resize({c->size.x, c->size.y, nw, nh}, true);
-                }
-            } break;
-            default: lg::warn("Unknown event type {} in resizemouse", ev.type); break;
-        }
-    } while (ev.type != ButtonRelease);
-    XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->size.w + c->bw - 1, c->size.h + c->bw - 1);
-    XUngrabPointer(dpy, CurrentTime);
-    while (XCheckMaskEvent(dpy, EnterWindowMask, &ev)) {
-        ;
-    }
-    if (auto m = recttomon(c->size); m != selmon) {
-        sendmon(c, m);
-        selmon = m;
-        focus(nullptr);
-    }
+    begindrag(DragKind::resize, c, c->size.x + c->size.w, c->size.y + c->size.h);
+    drag.sync = setupsync(c);
 }
 
 void restack(MonitorRef const &m) {
-    Client *c;
-    XEvent ev;
-    XWindowChanges wc;
-
     drawbar(m);
     if (!m->sel) {
         return;
     }
-    if (m->sel->props.isfloating || !m->lt[m->sellt]->arrange) {
-        XRaiseWindow(dpy, m->sel->win);
-    }
-    if (m->lt[m->sellt]->arrange) {
-        wc.stack_mode = Below;
-        wc.sibling = m->barwin;
-        for (c = m->stack; c; c = c->snext) {
-            if (!c->props.isfloating && c->isVisible()) {
-                XConfigureWindow(dpy, c->win, CWSibling | CWStackMode, &wc);
-                wc.sibling = c->win;
-            }
-        }
-    }
-    XSync(dpy, False);
-    while (XCheckMaskEvent(dpy, EnterWindowMask, &ev)) {
-        ;
+    if (transaction.depth) {
+        if (rng::find(transaction.restack, m) == transaction.restack.end()) transaction.restack.push_back(m);
+        return;
     }
+    if (applystacking(m)) ignorecrossings();
 }
 
 void rotatestack(int arg) {
@@ -1745,6 +2096,32 @@ void handle_notifyself_fade_anim(FadeBarEvent) {
     drawprogress(PROGRESS_FADE);
 }
 
+void screenchangenotify(XEvent *e) {
+    screenChanged(e);
+    monitors_dirty = true;
+}
+
+/* Ask `c` to tell when it has drawn the next configure, has to be sent before the configure */
+void sendsyncrequest(Client *c) {
+    XEvent ev;
+
+    c->syncvalue++;
+    ev.type = ClientMessage;
+    ev.xclient.window = c->win;
+    ev.xclient.message_type = wmatom[WMProtocols];
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = static_cast<long>(netatom[NetWMSyncRequest]);
+    ev.xclient.data.l[1] = CurrentTime;
+    ev.xclient.data.l[2] = static_cast<long>(c->syncvalue & 0xffff'ffffu);
+    ev.xclient.data.l[3] = static_cast<long>(c->syncvalue >> 32u);
+    ev.xclient.data.l[4] = 0;
+    /* if the client destroyed its counter the alarm never goes off (xerror ignores the error), applydrag times out */
+    syncSetAlarm(dpy, c->syncalarm, c->synccounter, c->syncvalue);
+    XSendEvent(dpy, c->win, False, NoEventMask, &ev);
+    c->syncwaiting = true;
+    c->syncsent = std::chrono::steady_clock::now();
+}
+
 void sendmon(Client *c, MonitorRef const &m) {
     if (c->getMon() == m) return;
 
@@ -1763,23 +2140,13 @@ void sendmon(Client *c, MonitorRef const &m) {
 }
 
 void Client::setclientstate(long state) const {
-    std::array data {state, None};
-
-    XChangeProperty(dpy,
-        win,
-        wmatom[WMState],
-        wmatom[WMState],
-        32,
-        PropModeReplace,
-        reinterpret_cast<unsigned char const *>(data.data()),
-        2);
+    propwriter.set32(win, wmatom[WMState], wmatom[WMState], std::array {state, static_cast<long>(None)});
 }
 
-bool Client::sendevent(Atom proto) const {
+bool Client::hasprotocol(Atom proto) const {
     int n;
     Atom *protocols;
     bool exists = false;
-    XEvent ev;
 
     if (XGetWMProtocols(dpy, win, &protocols, &n)) {
         while (!exists && n--) {
@@ -1787,6 +2154,13 @@ bool Client::sendevent(Atom proto) const {
         }
         XFree(protocols);
     }
+    return exists;
+}
+
+bool Client::sendevent(Atom proto) const {
+    XEvent ev;
+
+    bool exists = hasprotocol(proto);
     if (!exists) return false;
     ev.type = ClientMessage;
     ev.xclient.window = win;
@@ -1801,14 +2175,7 @@ bool Client::sendevent(Atom proto) const {
 void Client::setfocus() {
     if (!props.neverfocus) {
         XSetInputFocus(dpy, win, RevertToPointerRoot, CurrentTime);
-        XChangeProperty(dpy,
-            root,
-            netatom[NetActiveWindow],
-            XA_WINDOW,
-            32,
-            PropModeReplace,
-            reinterpret_cast<unsigned char const *>(&win),
-            1);
+        propwriter.set32(root, netatom[NetActiveWindow], XA_WINDOW, std::array {win});
     }
     (void)sendevent(wmatom[WMTakeFocus]);
 }
@@ -1816,14 +2183,7 @@ void Client::setfocus() {
 void Client::setfullscreen(FullScreen fullscreen) {
     if (fullscreen == FullScreen::on && !props.isfullscreen) {
         props.isfullscreen = FullScreen::on;
-        XChangeProperty(dpy,
-            win,
-            netatom[NetWMState],
-            XA_ATOM,
-            32,
-            PropModeReplace,
-            reinterpret_cast<unsigned char const *>(&netatom[NetWMFullscreen]),
-            1);
+        propwriter.set32(win, netatom[NetWMState], XA_ATOM, std::array {netatom[NetWMFullscreen]});
         props.isfullscreen = FullScreen::on;
         props.old_float_state = props.isfloating;
         oldbw = bw;
@@ -1831,8 +2191,13 @@ void Client::setfullscreen(FullScreen fullscreen) {
         props.isfloating = true;
         resizeclient(getMon()->monitor_size);
         XRaiseWindow(dpy, win);
+        /* the window is now above the bar, tiled clients have to be put back under it on exit */
+        getMon()->raised = win;
+        getMon()->stacking.clear();
+        stacking_dirty = true;
+        if (hide_occluded != Occluded::keep) arrange(getMon());
     } else if (fullscreen == FullScreen::off && props.isfullscreen) {
-        XChangeProperty(dpy, win, netatom[NetWMState], XA_ATOM, 32, PropModeReplace, nullptr, 0);
+        propwriter.set32(win, netatom[NetWMState], XA_ATOM, std::span<Atom const> {});
         props.isfullscreen = FullScreen::off;
         props.isfloating = props.old_float_state;
         bw = oldbw;
@@ -1905,10 +2270,13 @@ void setup() {
     sw = DisplayWidth(dpy, screen);
     sh = DisplayHeight(dpy, screen);
     root = RootWindow(dpy, screen);
-    drw = new Drw(dpy, screen, root, (unsigned)sw, (unsigned)sh);
+    drw = new Drw(dpy, screen, root);
+    drw->setFallbackFontBudget(fallback_font_memory, fallback_font_glyph_memory);
     if (!drw->fontset_create(fonts)) {
         lg::fatal("no fonts could be loaded.");
     }
+    /* log_dir is .../dwm/log/, the cache goes next to it */
+    drw->loadFontCache((log_dir / "..").lexically_normal() / "fonts.cache");
 
     if (bright_setup(get_bright_set_file(), get_bright_get_file(), get_bright_max_file())) {
         lg::fatal("backlight setup failed");
@@ -1921,6 +2289,8 @@ void setup() {
 
     lrpad = (int)drw->fonts().h;
     bar_height = (int)drw->fonts().h + 2;
+    for (std::size_t i = 0; i < tag_symbols.size(); i++)
+        tag_widths[i] = TEXTW(tag_symbols[i]);
     updategeom();
     /* init atoms */
     utf8string = XInternAtom(dpy, "UTF8_STRING", False);
@@ -1938,10 +2308,13 @@ void setup() {
     netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
     netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
     netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+    netatom[NetClientListStacking] = XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
     netatom[NetWMIcon] = XInternAtom(dpy, "_NET_WM_ICON", False);
     netatom[NetOpacity] = XInternAtom(dpy, "_NET_WM_WINDOW_OPACITY", False);
     netatom[NetBypassComp] = XInternAtom(dpy, "_NET_WM_BYPASS_COMPOSITOR", False);
     netatom[NetOpaqueRegion] = XInternAtom(dpy, "_NET_WM_OPAQUE_REGION", False);
+    netatom[NetWMSyncRequest] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST", False);
+    netatom[NetWMSyncRequestCounter] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST_COUNTER", False);
 
     drw->setColorScheme(colors);
 
@@ -1959,40 +2332,13 @@ void setup() {
     updatestatus();
     /* supporting window for NetWMCheck */
     wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
-    XChangeProperty(dpy,
-        wmcheckwin,
-        netatom[NetWMCheck],
-        XA_WINDOW,
-        32,
-        PropModeReplace,
-        reinterpret_cast<unsigned char const *>(&wmcheckwin),
-        1);
-    XChangeProperty(dpy,
-        wmcheckwin,
-        netatom[NetWMName],
-        utf8string,
-        8,
-        PropModeReplace,
-        reinterpret_cast<unsigned char const *>("dwm"),
-        3);
-    XChangeProperty(dpy,
-        root,
-        netatom[NetWMCheck],
-        XA_WINDOW,
-        32,
-        PropModeReplace,
-        reinterpret_cast<unsigned char const *>(&wmcheckwin),
-        1);
+    propwriter.set32(wmcheckwin, netatom[NetWMCheck], XA_WINDOW, std::array {wmcheckwin});
+    propwriter.set8(wmcheckwin, netatom[NetWMName], utf8string, "dwm");
+    propwriter.set32(root, netatom[NetWMCheck], XA_WINDOW, std::array {wmcheckwin});
     /* EWMH support per view */
-    XChangeProperty(dpy,
-        root,
-        netatom[NetSupported],
-        XA_ATOM,
-        32,
-        PropModeReplace,
-        reinterpret_cast<unsigned char const *>(netatom.data()),
-        NetLast);
-    XDeleteProperty(dpy, root, netatom[NetClientList]);
+    propwriter.set32(root, netatom[NetSupported], XA_ATOM, netatom);
+    propwriter.remove(root, netatom[NetClientList]);
+    propwriter.remove(root, netatom[NetClientListStacking]);
     /* select events */
     XSetWindowAttributes wa;
     wa.cursor = drw->cursors().normal();
@@ -2011,22 +2357,116 @@ void Client::seturgent(IsUrgent urg) {
     }
 }
 
-void showhide(Client *c) {
-    if (!c) {
-        return;
+void setoccluded(Client *c, bool occluded) {
+    if (c->occluded == occluded) return;
+    c->occluded = occluded;
+    if (occluded) {
+        /* with StructureNotifyMask off only the root window hears about it, unmapnotify skips that one event */
+        XSelectInput(dpy, c->win, CLIENTMASK & ~StructureNotifyMask);
+        XUnmapWindow(dpy, c->win);
+        XSelectInput(dpy, c->win, CLIENTMASK);
+        c->ignoreunmap++;
+        c->setclientstate(IconicState);
+    } else {
+        /* Mapped at its old geometry it would flash there until the transaction moves it. It is mapped right away
+         * off-screen instead, so that focus (which needs a viewable window) can go to it before the commit. */
+        if (transaction.depth) {
+            transaction.touch(c, c->size, c->winbw).from_bw = -1;
+            configurewindow(c, c->size, -1, true);
+        }
+        XMapWindow(dpy, c->win);
+        c->setclientstate(NormalState);
     }
-    if (c->isVisible()) {
-        /* show clients top down */
-        XMoveWindow(dpy, c->win, c->size.x, c->size.y);
+}
+
+void setparked(Client *c, bool parked) {
+    if (c->parked == parked) return;
+    c->parked = parked;
+    auto &change = transaction.touch(c, c->size, c->winbw);
+    change.offscreen = parked;
+    if (!parked && c->offscreen) change.from_bw = -1;
+}
+
+/* Check whether `c` does _NET_WM_SYNC_REQUEST and get its counter ready, done when a resize starts since that is the
+ * only thing which waits for it */
+bool setupsync(Client *c) {
+    if (!sync_available || !c->hasprotocol(netatom[NetWMSyncRequest])) return false;
+    auto counter = getCardinalProps(dpy, c, netatom[NetWMSyncRequestCounter]);
+    /* a second counter would be the extended one, the basic one is always first */
+    if (!counter || counter->empty()) return false;
+    c->synccounter = (*counter)[0];
+
+    /* the counter comes from the client, it may not exist */
+    XSetErrorHandler(xerrordummy);
+    auto value = syncCounterValue(dpy, c->synccounter);
+    XSync(dpy, False);
+    XSetErrorHandler(xerror);
+    if (!value) {
+        lg::debug("{} advertises _NET_WM_SYNC_REQUEST with a bad counter", c->name.view());
+        c->synccounter = None;
+        return false;
+    }
+    c->syncvalue = *value;
+    c->syncwaiting = false;
+    return true;
+}
+
+void showhide(Client *c) {
+    /* reused between calls, hidden clients are hidden bottom up after the visible ones are shown top down */
+    static std::vector<Client *> hidden;
+    hidden.clear();
+    for (; c; c = c->snext) {
+        if (!c->isVisible()) {
+            hidden.push_back(c);
+            continue;
+        }
+        /* parked ones stay where they are until arrangemon finds room for them */
+        if (c->offscreen && !c->parked) {
+            auto &change = transaction.touch(c, c->size, c->winbw);
+            change.offscreen = false;
+            change.from_bw = -1;
+        }
         if ((!c->getMon()->lt[c->getMon()->sellt]->arrange || c->props.isfloating) && !c->props.isfullscreen) {
             c->resize(c->size, false);
         }
-        showhide(c->snext);
-    } else {
-        /* hide clients bottom up */
-        showhide(c->snext);
-        XMoveWindow(dpy, c->win, static_cast<int>(WIDTH(c) * -2u), c->size.y);
     }
+    for (auto *h : hidden | vws::reverse)
+        transaction.touch(h, h->size, h->winbw).offscreen = true;
+}
+
+std::size_t tiledcapacity(MonitorRef const &m) {
+    auto const arrange = m->lt[m->sellt]->arrange;
+    auto const masters = static_cast<std::size_t>(std::max(m->nmaster, 0));
+    auto const rows = static_cast<std::size_t>(std::max(m->window_size.h / tiled_min_size, 1));
+    auto const cols = static_cast<std::size_t>(std::max(m->window_size.w / tiled_min_size, 1));
+    /* the master area is bounded like the stack, nmaster can be raised without limit */
+    if (arrange == tile) return std::min(masters, rows) + rows;
+    /* two stack columns */
+    if (arrange == centeredmaster) return std::min(masters, rows) + 2 * rows;
+    /* the masters and the stack are single rows */
+    if (arrange == centeredfloatingmaster) return std::min(masters, cols) + cols;
+    /* monocle, every client gets the whole area */
+    return std::numeric_limits<std::size_t>::max();
+}
+
+/* End the drag without touching the client, which may be going away. Puts back the handlers begindrag replaced */
+void stopdrag() {
+    loop->on<MotionNotify>(std::move(drag.prev_motion));
+    loop->on<ButtonPress>(std::move(drag.prev_press));
+    loop->on<ButtonRelease>(std::move(drag.prev_release));
+    XUngrabPointer(dpy, CurrentTime);
+    drag.c = nullptr;
+    drag.sync = false;
+    drag.motion = std::nullopt;
+}
+
+/* The client has drawn everything up to the value the alarm was set to */
+void syncalarmnotify(XEvent *e) {
+    auto const notify = syncAlarmNotify(e);
+    if (!drag.c || drag.c->syncalarm != notify.alarm || notify.value < drag.c->syncvalue) return;
+    drag.c->syncwaiting = false;
+    /* don't wait for the end of the tick, resizing should go as fast as the client can draw */
+    applydrag();
 }
 
 void spawn(char const *const *arg) {
@@ -2051,7 +2491,7 @@ void tagmon(int arg) {
     sendmon(selmon->sel, dirtomon(arg));
 }
 
-void tile(MonitorRef const &m) {
+void tile(MonitorRef const &m, TiledClients const &tiled) {
     unsigned int i;
     unsigned int n;
     unsigned int h;
@@ -2062,11 +2502,12 @@ void tile(MonitorRef const &m) {
     float sfacts = 0;
     Client *c;
 
-    for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++)
-        if (std::cmp_less(n, m->nmaster))
-            mfacts += c->cfact;
+    n = (unsigned)tiled.clients.size();
+    for (i = 0; i < n; i++)
+        if (std::cmp_less(i, m->nmaster))
+            mfacts += tiled.clients[i]->cfact;
         else
-            sfacts += c->cfact;
+            sfacts += tiled.clients[i]->cfact;
 
     if (n == 0) return;
 
@@ -2076,7 +2517,8 @@ void tile(MonitorRef const &m) {
     else
         mw = (unsigned)m->window_size.w;
 
-    for (i = my = ty = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+    for (i = my = ty = 0; i < n; i++) {
+        c = tiled.clients[i];
         if (std::cmp_less(i, m->nmaster)) {
             h = (unsigned)((float)((unsigned)m->window_size.h - my) * (c->cfact / mfacts));
             c->resize(
@@ -2087,8 +2529,7 @@ void tile(MonitorRef const &m) {
                     (int)(h - (2 * (unsigned)c->bw)),
                 },
                 false);
-            // TODO(dk949): This is a guard against creating too many clients.
-            //              Do something if there's too many clients!
+            /* arrangemon parks what does not fit, this only keeps cfact rounding on screen */
             if (my + HEIGHT(c) < (unsigned)m->window_size.h) {
                 my += HEIGHT(c);
                 mfacts -= c->cfact;
@@ -2204,7 +2645,7 @@ void Client::unfocus(bool setfocus) {
     XSetWindowBorder(dpy, win, drw->scheme().norm.border.pixel);
     if (setfocus) {
         XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
-        XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+        propwriter.remove(root, netatom[NetActiveWindow]);
     }
 }
 
@@ -2215,10 +2656,12 @@ static void uniconifyclient(Client *c) {
     arrange(c->getMon());
     XMapWindow(dpy, c->win);
     XMoveResizeWindow(dpy, c->win, c->size.x, c->size.y, static_cast<unsigned>(c->size.w), static_cast<unsigned>(c->size.h));
+    c->offscreen = false;
     c->configure();
     c->setclientstate(NormalState);
     attachstack(c);
     attach(c);
+    clientlistadd(c->win);
 }
 
 void unmanage(Client *c, IsDestroyed destroyed) {
@@ -2229,6 +2672,9 @@ void unmanage(Client *c, IsDestroyed destroyed) {
         unswallow(c);
         return;
     }
+    if (m->raised == c->win) m->raised = None;
+    if (drag.c == c) stopdrag();
+    if (c->syncalarm) syncDestroyAlarm(dpy, c->syncalarm);
 
     Client *s = swallowingclient(c->win);
     if (s) {
@@ -2247,6 +2693,7 @@ void unmanage(Client *c, IsDestroyed destroyed) {
         XGrabServer(dpy); /* avoid race conditions */
         XSetErrorHandler(xerrordummy);
         XSelectInput(dpy, c->win, NoEventMask);
+        if (c->occluded) XMapWindow(dpy, c->win);
         XConfigureWindow(dpy, c->win, CWBorderWidth, &wc); /* restore border */
         XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
         c->setclientstate(WithdrawnState);
@@ -2254,11 +2701,11 @@ void unmanage(Client *c, IsDestroyed destroyed) {
         XSetErrorHandler(xerror);
         XUngrabServer(dpy);
     }
+    clientlistremove(c->win);
     delete ensureUnattached(c);
     if (!s) {
         arrange(m);
         focus(nullptr);
-        updateclientlist();
         if (switchtotag) {
             view(switchtotag);
         }
@@ -2275,7 +2722,16 @@ void unmapnotify(XEvent *e) {
     XUnmapEvent *ev = &e->xunmap;
 
     if ((c = wintoclient(ev->window))) {
-        if (ev->send_event) {
+        if (!ev->send_event && c->ignoreunmap > 0) {
+            c->ignoreunmap--;
+            return;
+        }
+        if (ev->send_event && c->occluded) {
+            /* dwm unmapped it already, so this synthetic event is the only sign the client withdrew. It must stay
+             * unmapped, which unmanage would undo for an occluded client */
+            c->occluded = false;
+            unmanage(c, IsDestroyed::no);
+        } else if (ev->send_event) {
             c->setclientstate(WithdrawnState);
         } else {
             unmanage(c, IsDestroyed::no);
@@ -2341,91 +2797,167 @@ void updatebarpos(MonitorRef const &m) {
 }
 
 void updateclientlist() {
-    Client *c;
+    /* reused between calls */
+    static std::vector<Client *> stacked;
 
-    XDeleteProperty(dpy, root, netatom[NetClientList]);
+    if (client_list_dirty) {
+        propwriter.set32(root, netatom[NetClientList], XA_WINDOW, client_list);
+        client_list_dirty = false;
+    }
+    if (!stacking_dirty) return;
+    stacking_dirty = false;
+
+    /* bottom to top, tiled clients are kept under the bar and floating ones are raised when focused */
+    stacked.clear();
     for (auto const &mon : mons) {
-        for (c = mon->clients; c; c = c->next) {
-            XChangeProperty(dpy,
-                root,
-                netatom[NetClientList],
-                XA_WINDOW,
-                32,
-                PropModeAppend,
-                reinterpret_cast<unsigned char const *>(&c->win),
-                1);
-        }
+        auto const first = static_cast<std::ptrdiff_t>(stacked.size());
+        for (Client *c = mon->stack; c; c = c->snext)
+            stacked.push_back(c);
+        std::reverse(stacked.begin() + first, stacked.end());
+        std::stable_partition(stacked.begin() + first, stacked.end(), [](Client const *c) {
+            return !c->props.isfloating;
+        });
     }
+    propwriter.set32(root,
+        netatom[NetClientListStacking],
+        XA_WINDOW,
+        stacked | vws::transform([](Client const *c) noexcept { return c->win; }));
 }
 
-bool updategeom() {
-    bool dirty = false;
-
+/* Bring `mons` in line with the screens. Monitors are matched to screens by output (or by geometry if the backend
+ * cannot tell outputs apart) so that a screen coming or going leaves the others untouched. Returns the monitors which
+ * are new, were resized or took the clients of a removed monitor, only those need to be arranged again. */
+std::vector<MonitorRef> updategeom() {
+    std::vector<ScreenInfo> screens;
     if (xineramaIsActive(dpy)) {
-        std::size_t j = 0;
-        Client *c;
         auto info = ScreenInfoPtr::query(dpy);
-        std::size_t num_screen_infos = info.count();
+        screens.reserve(info.count());
         /* only consider unique geometries as separate screens */
-        // auto *unique = new ScreenInfo[num_screen_infos];
-        std::vector<ScreenInfo> unique;
-        unique.resize(num_screen_infos);
-        for (size_t i = 0; i < num_screen_infos; i++) {
-            if (isuniquegeom(unique, j, info[i])) {
-                unique[j++] = info[i];
-            }
+        for (std::size_t i = 0; i < info.count(); i++) {
+            auto const s = info[i];
+            if (rng::none_of(screens, [&](ScreenInfo const &u) {
+                    return u.x_org == s.x_org && u.y_org == s.y_org && u.width == s.width && u.height == s.height;
+                }))
+                screens.push_back(s);
+        }
+    }
+    if (screens.empty()) { /* default monitor setup */
+        screens.push_back({
+            .screen_number = 0,
+            .x_org = 0,
+            .y_org = 0,
+            .width = static_cast<short>(sw),
+            .height = static_cast<short>(sh),
+            .id = 0,
+        });
+    }
+
+    auto geometry = [](ScreenInfo const &s) { return Rect<int> {s.x_org, s.y_org, s.width, s.height}; };
+    Monitors left = std::move(mons);
+    mons.assign(screens.size(), nullptr);
+    auto take = [&](auto pred) -> MonitorRef {
+        auto it = rng::find_if(left, pred);
+        if (it == left.end()) return nullptr;
+        auto m = *it;
+        left.erase(it);
+        return m;
+    };
+    /* the same output (or the same geometry) keeps its monitor... */
+    for (auto &&[m, s] : vws::zip(mons, screens))
+        m = take([&](MonitorRef const &o) {
+            return s.id ? o->output == s.id : o->monitor_size == geometry(s);
+        });
+    /* ...then whatever is left over is reused in order, so a single screen changing resolution keeps its state */
+    for (auto &m : mons)
+        if (!m) m = take([](auto const &) { return true; });
+
+    std::vector<MonitorRef> changed;
+    for (auto &&[m, s, i] : vws::zip(mons, screens, vws::iota(0))) {
+        if (!m) m = createmon();
+        m->num = i;
+        m->output = s.id;
+        if (m->monitor_size != geometry(s)) {
+            m->monitor_size = m->window_size = geometry(s);
+            updatebarpos(m);
+            changed.push_back(m);
+        }
+    }
+    /* less monitors available, their clients go to the first one */
+    for (auto const &mon : left | vws::reverse) {
+        Client *c;
+        while ((c = mon->clients)) {
+            mon->clients = c->next;
+            detachstack(c);
+            c->mon = mons.front();
+            attachaside(c);
+            attachstack(c);
         }
-        num_screen_infos = j;
-        /* new monitors available */
-        for (auto i = mons.size(); i < num_screen_infos; i++) {
-            mons.push_back(createmon());
-        }
-        for (auto const &[mon, u, i] : vws::zip(mons | vws::take(num_screen_infos), unique, vws::iota(0))) {
-            if (u.x_org != mon->monitor_size.x     //
-                || u.y_org != mon->monitor_size.y  //
-                || u.width != mon->monitor_size.w  //
-                || u.height != mon->monitor_size.h) {
-                dirty = true;
-                mon->num = i;
-                mon->monitor_size.x = mon->window_size.x = u.x_org;
-                mon->monitor_size.y = mon->window_size.y = u.y_org;
-                mon->monitor_size.w = mon->window_size.w = u.width;
-                mon->monitor_size.h = mon->window_size.h = u.height;
-                updatebarpos(mon);
+        if (rng::find(changed, mons.front()) == changed.end()) changed.push_back(mons.front());
+        if (mon == selmon) selmon = mons.front();
+        cleanupmon(mon);
+    }
+    if (!changed.empty()) {
+        selmon = mons.front();
+        selmon = wintomon(root);
+    }
+    return changed;
+}
+
+/* Apply screen layout changes once per tick, RandR sends a burst of events for a single hotplug */
+void updatemonitors() {
+    if (!monitors_dirty) return;
+    monitors_dirty = false;
+
+    auto const changed = updategeom();
+    if (changed.empty()) return;
+    updatebars();
+    for (auto const &m : changed) {
+        for (Client *c = m->clients; c; c = c->next) {
+            if (c->props.isfullscreen == FullScreen::on) {
+                c->resizeclient(m->monitor_size);
             }
         }
-        /* less monitors available nn < n */
-        for (auto const &mon : mons | vws::drop(num_screen_infos) | vws::reverse) {
-            while ((c = mon->clients)) {
-                dirty = true;
-                mon->clients = c->next;
-                detachstack(c);
-                c->mon = mons.front();
-                attach(c);
-                attachaside(c);
-                attachstack(c);
+        XMoveResizeWindow(dpy,
+            m->barwin,
+            m->window_size.x,
+            m->bar_y,
+            static_cast<unsigned>(m->window_size.w),
+            static_cast<unsigned>(bar_height));
+    }
+    focus(nullptr);
+    {
+        TransactionScope tx;
+        for (auto const &m : changed)
+            arrange(m);
+    }
+    IF_DEBUG logpixmapbytes();
+}
+
+/* Read the titles and WM hints propertynotify only marked as changed. The bar only shows the selected client's title,
+ * so only that one is read, at most every title_refresh_ms. The rest are read when they are focused. WM hints are
+ * needed for the urgency markers, they are read once per tick no matter how many changes came in. */
+void updatelazyprops() {
+    if (!lazy_props_pending) return;
+    lazy_props_pending = false;
+
+    auto const now = std::chrono::steady_clock::now();
+    bool redraw = false;
+    for (auto const &m : mons) {
+        for (Client *c = m->clients; c; c = c->next) {
+            if (c->wmhintsdirty) {
+                c->updatewmhints();
+                redraw = true;
             }
-            if (mon == selmon) selmon = mons.front();
-            cleanupmon(mon);
-        }
-        if (auto erase_start = mons.begin() + (long)num_screen_infos; erase_start <= mons.end())
-            mons.erase(erase_start, mons.end());
-    } else { /* default monitor setup */
-        if (mons.empty()) {
-            mons.push_back(createmon());
-        }
-        if (mons.front()->monitor_size.w != sw || mons.front()->monitor_size.h != sh) {
-            dirty = true;
-            mons.front()->monitor_size.w = mons.front()->window_size.w = sw;
-            mons.front()->monitor_size.h = mons.front()->window_size.h = sh;
-            updatebarpos(mons.front());
+            if (!c->titledirty || c != m->sel) continue;
+            if (now - c->titletime < std::chrono::milliseconds {title_refresh_ms}) {
+                lazy_props_pending = true;
+                continue;
+            }
+            c->updatetitle();
+            redraw = true;
         }
     }
-    if (dirty) {
-        selmon = mons.front();
-        selmon = wintomon(root);
-    }
-    return dirty;
+    if (redraw) drawbars();
 }
 
 void updatenumlockmask() {
@@ -2449,6 +2981,7 @@ void Client::updatesizehints() {
     long user_size;
     XSizeHints size_hints;
 
+    hints_epoch++;
     if (!XGetWMNormalHints(dpy, win, &size_hints, &user_size)) {
         /* size is uninitialized, ensure that size.flags aren't used */
         size_hints.flags = PSize;
@@ -2497,10 +3030,28 @@ void updatestatus() {
     if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
         std::format_to_n(stext, sizeof(stext), "dwm-{}", dwm::version::full);
 
+    if (status_text.update(stext)) {
+        status_styles.clear();
+        status_width = 0;
+        for (auto const &segment : status_text.segments()) {
+            auto const *scheme = segment.scheme.empty() ? nullptr : drw->schemeByName(segment.scheme);
+            if (!segment.scheme.empty() && !scheme) lg::debug("unknown color scheme in status: '{}'", segment.scheme);
+            Color color = scheme ? *scheme : drw->scheme().status;
+            if (segment.fg) color.fg = drw->rgbColor(*segment.fg);
+            if (segment.bg) color.bg = drw->rgbColor(*segment.bg);
+            auto width = drw->fontset_getwidth(segment.text.c_str());
+            status_styles.push_back({.color = color, .width = width});
+            status_width += width;
+        }
+        /* a status which keeps changing colors (e.g. a gradient) would otherwise allocate new ones forever */
+        drw->pruneRgbColors();
+    }
     drawbar(selmon);
 }
 
 void Client::updatetitle() {
+    titledirty = false;
+    titletime = std::chrono::steady_clock::now();
     if (!gettextprop(win, netatom[NetWMName], name.data(), name.max_size()))
         gettextprop(win, XA_WM_NAME, name.data(), name.max_size());
 
@@ -2521,6 +3072,7 @@ void Client::updatewindowtype() {
 }
 
 void Client::updatewmhints() {
+    wmhintsdirty = false;
 
     if (auto wmh = XPtr<XWMHints>(XGetWMHints(dpy, win))) {
         if (this == selmon->sel && wmh->flags & XUrgencyHint) {
@@ -2542,6 +3094,9 @@ void winpicker() {
     auto total_client_count =
         rng::fold_left(mons, 0uz, [](auto count, auto const &mon) noexcept { return count + mon->clients->count(); });
     if (total_client_count == 0) return;
+    for (auto const &mon : mons)
+        for (Client *c = mon->clients; c; c = c->next)
+            if (c->titledirty) c->updatetitle();
     auto args = winpickerCreateDmenuCommand(dpy, mons, selmon->num);
     loop->spawn(std::move(args),
         EventLoop::SpawnConfig {.keep_stdout = true, .keep_stderr = true},
@@ -2603,6 +3158,7 @@ void view(unsigned arg) {
         togglebar();
     }
 
+    TransactionScope tx;
     focus(nullptr);
     arrange(selmon);
 }
@@ -2625,6 +3181,19 @@ void volumechange(int arg) {
 #endif
 
 
+/* Log how much pixmap memory the server holds for dwm, mostly the bar back buffers */
+void logpixmapbytes() {
+    xcb_generic_error_t *e = nullptr;
+    auto c = xcb_res_query_client_pixmap_bytes(xcon, (uint32_t)wmcheckwin);
+    auto *r = xcb_res_query_client_pixmap_bytes_reply(xcon, c, &e);
+    if (!r) {
+        free(e);
+        return;
+    }
+    lg::debug("server side pixmap memory: {} bytes", ((uint64_t)r->bytes_overflow << 32) | r->bytes);
+    free(r);
+}
+
 pid_t winpid(Window w) {
     pid_t result = 0;
 
@@ -2779,9 +3348,9 @@ static void iconifyclient(Client *c) {
 
     c->setclientstate(IconicState);
     XUnmapWindow(dpy, c->win);
+    clientlistremove(c->win);
 
     arrange(c->getMon());
-    updateclientlist();
     unsigned long size;
     uint32_t *icon;
     if ((icon = geticon(c, &size))) {
@@ -2810,6 +3379,18 @@ void installEventHandlers() {
     loop->on<PropertyNotify>(propertynotify);
     loop->on<UnmapNotify>(unmapnotify);
     loop->on<FadeBarEvent>(handle_notifyself_fade_anim);
+    for (auto type : selectScreenChanges(dpy, root))
+        loop->onExtension(type, screenchangenotify);
+    if (auto type = syncInit(dpy)) {
+        sync_available = true;
+        loop->onExtension(*type, syncalarmnotify);
+    }
+    loop->onTickEnd(applydrag);
+    loop->onTickEnd(updatemonitors);
+    loop->onTickEnd(updatelazyprops);
+    loop->onTickEnd(updateclientlist);
+    /* last, so it sends what the other hooks wrote */
+    loop->onTickEnd([] { propwriter.flush(dpy); });
 }
 
 bool isdescprocess(pid_t p, pid_t c) {
@@ -2894,7 +3475,7 @@ int xerror(Display *d, XErrorEvent *ee) {
         || (ee->request_code == X_ConfigureWindow && ee->error_code == BadMatch)
         || (ee->request_code == X_GrabButton && ee->error_code == BadAccess)
         || (ee->request_code == X_GrabKey && ee->error_code == BadAccess)
-        || (ee->request_code == X_CopyArea && ee->error_code == BadDrawable)) {
+        || (ee->request_code == X_CopyArea && ee->error_code == BadDrawable) || syncIsCounterError(ee)) {
         return 0;
     }
     lg::warn("fatal error: request code={}, error code={}", ee->request_code, ee->error_code);
@@ -2963,7 +3544,7 @@ int main(int argc, char *argv[]) {
     return EXIT_SUCCESS;
 }
 
-void centeredmaster(MonitorRef const &m) {
+void centeredmaster(MonitorRef const &m, TiledClients const &tiled) {
     unsigned int i;
     unsigned int n;
     unsigned int h;
@@ -2975,10 +3556,7 @@ void centeredmaster(MonitorRef const &m) {
     unsigned int tw;
     Client *c;
 
-    /* count number of clients in the selected monitor */
-    for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++) {
-        ;
-    }
+    n = (unsigned)tiled.clients.size();
     if (n == 0) {
         return;
     }
@@ -3003,7 +3581,8 @@ void centeredmaster(MonitorRef const &m) {
 
     oty = 0;
     ety = 0;
-    for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+    for (i = 0; i < n; i++) {
+        c = tiled.clients[i];
         if (std::cmp_less(i, m->nmaster)) {
             /* nmaster clients are stacked vertically, in the center
              * of the screen */
@@ -3016,8 +3595,7 @@ void centeredmaster(MonitorRef const &m) {
                     (int)(h - (unsigned)(2 * c->bw)),
                 },
                 false);
-            // TODO(dk949): This is a guard against creating too many clients.
-            //              Do something if there's too many clients!
+            /* arrangemon parks what does not fit, this only keeps rounding on screen */
             // TODO(dk949): make this cfact aware
             if (my + HEIGHT(c) < (unsigned)m->window_size.h) my += HEIGHT(c);
         } else {
@@ -3032,8 +3610,7 @@ void centeredmaster(MonitorRef const &m) {
                         (int)(h - (unsigned)(2 * c->bw)),
                     },
                     false);
-                // TODO(dk949): This is a guard against creating too many clients.
-                //              Do something if there's too many clients!
+                /* arrangemon parks what does not fit, this only keeps rounding on screen */
                 // TODO(dk949): make this cfact aware
                 if (ety + HEIGHT(c) < (unsigned)m->window_size.h) ety += HEIGHT(c);
             } else {
@@ -3052,7 +3629,7 @@ void centeredmaster(MonitorRef const &m) {
     }
 }
 
-void centeredfloatingmaster(MonitorRef const &m) {
+void centeredfloatingmaster(MonitorRef const &m, TiledClients const &tiled) {
     unsigned int i;
     unsigned int n;
     unsigned int w;
@@ -3065,10 +3642,7 @@ void centeredfloatingmaster(MonitorRef const &m) {
     unsigned int tx;
     Client *c;
 
-    /* count number of clients in the selected monitor */
-    for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++) {
-        ;
-    }
+    n = (unsigned)tiled.clients.size();
     if (n == 0) {
         return;
     }
@@ -3093,7 +3667,8 @@ void centeredfloatingmaster(MonitorRef const &m) {
         my = myo = 0;
     }
 
-    for (i = tx = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+    for (i = tx = 0; i < n; i++) {
+        c = tiled.clients[i];
         if (std::cmp_less(i, m->nmaster)) {
             /* nmaster clients are stacked horizontally, in the center
              * of the screen */
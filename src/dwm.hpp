@@ -1,6 +1,7 @@
 #ifndef DWM_HPP
 #define DWM_HPP
 
+#include "bar.hpp"
 #include "boolenum.hpp"
 #include "layout.hpp"
 #include "log.hpp"
@@ -10,9 +11,12 @@
 #include <X11/X.h>
 #include <X11/Xutil.h>
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <format>
 #include <stdexcept>
+#include <vector>
 
 struct Pertag;
 struct Monitor;
@@ -29,6 +33,8 @@ struct Rect {
     T w;
     T h;
 
+    bool operator==(Rect const &) const = default;
+
     T operator[](std::size_t idx) {
         switch (idx) {
             case 0: return x;
@@ -71,8 +77,18 @@ struct Monitor {
     Client *sel;
     Client *stack;
     Window barwin;
+    /// `ScreenInfo::id` of the screen the monitor is on, 0 if the backend does not identify screens
+    unsigned long output;
     std::array<Layout const *, 2> lt;
     Pertag *pertag;
+    BarSegments bar;
+    BarHitMap bar_hits;
+    /// Whether the last arrange placed tiled clients without gaps and borders, see `TiledClients::gapless`
+    bool gapless;
+    /// Bar followed by the tiled clients, in the order restack last applied it to the server
+    std::vector<Window> stacking;
+    /// Floating client restack last raised, None if something may have been raised over it since
+    Window raised;
 };
 
 struct ClientProps {
@@ -94,7 +110,30 @@ struct Client {
     Rect<int> old_size;
     int basew, baseh, incw, inch, maxw, maxh, minw, minh;
     bool hintsvalid;
+    /// The title or WM hints changed since they were last read, see updatelazyprops
+    bool titledirty, wmhintsdirty;
+    /// When the title was last read
+    std::chrono::steady_clock::time_point titletime;
     int bw, oldbw;
+    /// Border width currently set on the window (layouts can remove the border), -1 if unknown
+    int winbw;
+    /// Moved off-screen because the layout ran out of room for it (see tiledcapacity) or it is occluded
+    bool parked;
+    /// Unmapped by dwm because it is covered by another client, see `hide_occluded`
+    bool occluded;
+    /// The window was moved off-screen (hidden tag, parked or not shown yet)
+    bool offscreen;
+    /// Number of UnmapNotify events caused by dwm unmapping the window
+    int ignoreunmap;
+    /// _NET_WM_SYNC_REQUEST_COUNTER of the window, None if it does not do sync requests (checked when a resize starts)
+    XID synccounter;
+    /// Goes off when the client has redrawn after the last sync request, see sendsyncrequest
+    XID syncalarm;
+    /// Value of the last sync request
+    std::uint64_t syncvalue;
+    /// A sync request was sent and the client has not redrawn yet
+    bool syncwaiting;
+    std::chrono::steady_clock::time_point syncsent;
     unsigned int tags;
     unsigned int switchtotag;
     ClientProps props;
@@ -138,6 +177,8 @@ struct Client {
     [[nodiscard]]
     MonitorRef getMon();
     [[nodiscard]]
+    bool hasprotocol(Atom proto) const;
+    [[nodiscard]]
     bool sendevent(Atom proto) const;
     [[nodiscard]]
     Atom getatomprop(Atom prop) const;
@@ -107,14 +107,14 @@ EventLoop::EventLoop(Display *dpy, Window root)
  *      3. Use https://stackoverflow.com/questions/29001189/how-to-stop-an-x11-event-loop-gracefully-asynchronously
  *         to wait for X events until next frame.
  *          a. After handling all X events, go back to waiting for more if there's time until next frame,
- *             go to 1. if not.
+ *             go to 4. if not.
+ *      4. Run the tick end hooks (work coalesced over the whole tick, e.g. writing the client list), go to 1.
  *  * In the happy case this should look like waking up every 16ms, checking that internal queue is empty,
  *    then going to sleep again.
  *  * X events and internal events can both generate new internal events, these go to the new active queue and
  *    are not processed this frame.
- *  * There will be potential issues with `movemouse` and `resizemouse`, since these process events out of order.
- *    To start this should be OK (there aren't currently any internal events this will interfere with), but
- *    eventually I want to be able to dynamically replace X event handlers.
+ *  * Modal states (e.g. `movemouse` and `resizemouse`) swap X event handlers with `on` instead of running their own
+ *    loop, so the rest of the events keep being handled while they are active.
  */
 void EventLoop::run() {
     XSync(m_dpy, False);
@@ -126,6 +126,8 @@ void EventLoop::run() {
             swapQueues();
             runQueueEvents(m_inactive_queue);
             handleXEvents(tick_start + tick_time);
+            for (auto const &fn : m_on_tick_end)
+                fn();
         }
         logger.tickEnd();
         logger.log();
@@ -177,6 +179,10 @@ void EventLoop::flushXEvents() {
             lg::error("XNextEvent error: {}", xstrerror(m_dpy, err));
             break;
         }
+        if (ev.type >= LASTEvent) {
+            if (auto it = m_ext_handlers.find(ev.type); it != m_ext_handlers.end() && it->second) it->second(&ev);
+            continue;
+        }
         auto &&handler = m_x_handlers[static_cast<std::size_t>(ev.type)];
         if (handler) handler(&ev);
     }
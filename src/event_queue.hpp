@@ -18,6 +18,7 @@
 #include <string>
 #include <utility>
 #include <variant>
+#include <vector>
 
 struct FadeBarEvent { };
 
@@ -68,12 +69,15 @@ private:
 
     // TODO(dk949): Make this more type-safe (use tuple for xevents too)
     std::array<std::function<void(XEvent *)>, LASTEvent> m_x_handlers;
+    /// Extension events, their types are only known at runtime
+    std::flat_map<int, std::function<void(XEvent *)>> m_ext_handlers;
     map_tuple_types_t<variant_to_tuple_t<InternalEvent>, EvFn> m_intern_handlers;
 
     std::array<InternalQueue, 2> m_queues;
     InternalQueue *m_active_queue = &m_queues[0];
     InternalQueue *m_inactive_queue = &m_queues[1];
     std::flat_map<pid_t, std::pair<Proc, ProcOnExit>> m_on_proc_exit;
+    std::vector<std::function<void()>> m_on_tick_end;
 
     EventLogger<dwm::log_events> logger;
 
@@ -97,6 +101,12 @@ public:
         return std::exchange(m_x_handlers[Ev], std::forward<Fn>(fn));
     }
 
+    /// Handle an extension event, `type` is the extension's event base plus the event number
+    template<typename Fn>
+    auto onExtension(int type, Fn &&fn) {
+        return std::exchange(m_ext_handlers[type], std::forward<Fn>(fn));
+    }
+
     template<InVariant<InternalEvent> Ev, typename Fn>
     auto on(Fn &&fn) {
         return std::exchange(  //
@@ -104,6 +114,11 @@ public:
             std::forward<Fn>(fn));
     }
 
+    /// Run `fn` at the end of every tick, after all of the tick's events have been handled
+    void onTickEnd(std::function<void()> fn) {
+        m_on_tick_end.push_back(std::move(fn));
+    }
+
     template<int Ev>
     void exec(XEvent *ev) {
         if (m_x_handlers[Ev]) m_x_handlers[Ev](ev);
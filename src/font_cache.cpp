@@ -0,0 +1,197 @@
+#include "font_cache.hpp"
+
+#include "file.hpp"
+#include "log.hpp"
+#include "strerror.hpp"
+#include "util.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+static constexpr char cache_magic[8] = {'d', 'w', 'm', 'f', 'o', 'n', 't', '\0'};
+static constexpr std::uint32_t cache_version = 1;
+
+/// Changes whenever a fontconfig configuration file or a font directory is added, removed or modified
+static std::uint64_t fontconfigStamp() {
+    auto hash = fnv1a(std::to_string(FcGetVersion()));
+    auto add = [&](FcStrList *list) {
+        if (!list) return;
+        while (FcChar8 *name = FcStrListNext(list)) {
+            struct stat st;
+            hash = fnv1a((char const *)name, hash);
+            if (stat((char const *)name, &st) == 0)
+                hash = fnv1a(std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec), hash);
+        }
+        FcStrListDone(list);
+    };
+    add(FcConfigGetConfigFiles(nullptr));
+    add(FcConfigGetFontDirs(nullptr));
+    return hash;
+}
+
+FontCache::FontCache(std::filesystem::path path, std::uint64_t fontset_hash)
+        : m_path(std::move(path))
+        , m_fontconfig_stamp(fontconfigStamp())
+        , m_fontset_hash(fontset_hash) {
+    load();
+}
+
+FontCache::~FontCache() {
+    unmap();
+}
+
+void FontCache::unmap() noexcept {
+    if (m_map) munmap(m_map, m_map_size);
+    m_map = nullptr;
+    m_map_size = 0;
+    m_ranges = {};
+    m_strings = {};
+}
+
+void FontCache::load() {
+    int fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) lg::warn("could not open font cache {}: {}", m_path.c_str(), strError(errno));
+        return;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (std::size_t)st.st_size >= sizeof(Header))
+        map = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the file is closed
+    close(fd);
+    if (map == MAP_FAILED) {
+        lg::warn("could not map font cache {}", m_path.c_str());
+        return;
+    }
+    auto size = (std::size_t)st.st_size;
+    m_map = map;
+    m_map_size = size;
+
+    Header header;
+    std::memcpy(&header, m_map, sizeof(header));
+    auto ranges_size = (std::size_t)header.range_count * sizeof(Range);
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version
+        || sizeof(Header) + ranges_size + header.strings_size != size) {
+        lg::warn("font cache {} is corrupted, ignoring it", m_path.c_str());
+        return unmap();
+    }
+    if (header.fontconfig_stamp != m_fontconfig_stamp || header.fontset_hash != m_fontset_hash) {
+        lg::debug("font cache {} is out of date", m_path.c_str());
+        m_dirty = true;
+        return unmap();
+    }
+
+    auto const *bytes = static_cast<char const *>(m_map);
+    m_ranges = {reinterpret_cast<Range const *>(bytes + sizeof(Header)), header.range_count};
+    m_strings = {bytes + sizeof(Header) + ranges_size, header.strings_size};
+    if ((!m_strings.empty() && m_strings.back() != '\0')
+        || !std::ranges::all_of(m_ranges, [&](Range const &r) {
+               return r.first <= r.last && (r.file == Range::no_file || r.file < m_strings.size());
+           })) {
+        lg::warn("font cache {} is corrupted, ignoring it", m_path.c_str());
+        return unmap();
+    }
+}
+
+std::optional<FontCache::Target> FontCache::find(FcChar32 codepoint) const {
+    if (auto it = m_new.find(codepoint); it != m_new.end())
+        return Target {.file = it->second.file.empty() ? nullptr : it->second.file.c_str(), .index = it->second.index};
+
+    // ranges are sorted and do not overlap
+    auto it = std::ranges::upper_bound(m_ranges, codepoint, {}, &Range::first);
+    if (it == m_ranges.begin()) return std::nullopt;
+    --it;
+    if (codepoint > it->last) return std::nullopt;
+    return Target {.file = it->file == Range::no_file ? nullptr : m_strings.data() + it->file, .index = it->index};
+}
+
+void FontCache::record(FcChar32 codepoint, char const *file, int index) {
+    m_new.insert_or_assign(codepoint, NewEntry {.file = file ? file : "", .index = index});
+    m_dirty = true;
+}
+
+void FontCache::invalidate() {
+    unmap();
+    m_dirty = true;
+}
+
+void FontCache::save() {
+    if (!m_dirty) return;
+
+    struct Entry {
+        FcChar32 first;
+        FcChar32 last;
+        std::string_view file;
+        int index;
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve(m_ranges.size() + m_new.size());
+    for (auto const &r : m_ranges)
+        entries.push_back({
+            .first = r.first,
+            .last = r.last,
+            .file = r.file == Range::no_file ? std::string_view {} : std::string_view {m_strings.data() + r.file},
+            .index = r.index,
+        });
+    for (auto const &[codepoint, e] : m_new)
+        entries.push_back({.first = codepoint, .last = codepoint, .file = e.file, .index = e.index});
+    std::ranges::sort(entries, {}, &Entry::first);
+
+    // merge neighbouring codepoints resolved to the same font, and build the string table
+    std::vector<Range> ranges;
+    std::string strings;
+    std::map<std::string_view, std::uint32_t> string_offsets;
+    for (auto const &e : entries) {
+        auto file = Range::no_file;
+        if (!e.file.empty()) {
+            auto [it, inserted] = string_offsets.try_emplace(e.file, (std::uint32_t)strings.size());
+            if (inserted) strings.append(e.file).push_back('\0');
+            file = it->second;
+        }
+        if (!ranges.empty() && ranges.back().last + 1 == e.first && ranges.back().file == file
+            && ranges.back().index == e.index)
+            ranges.back().last = e.last;
+        else
+            ranges.push_back({.first = e.first, .last = e.last, .file = file, .index = e.index});
+    }
+
+    Header header {};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.range_count = (std::uint32_t)ranges.size();
+    header.fontconfig_stamp = m_fontconfig_stamp;
+    header.fontset_hash = m_fontset_hash;
+    header.strings_size = (std::uint32_t)strings.size();
+
+    // write to a temporary file and rename it over the old one, so a running dwm never sees a partial cache
+    auto tmp_path = m_path;
+    tmp_path += ".tmp";
+    {
+        FilePtr file {fopen(tmp_path.c_str(), "wb")};
+        if (!file) {
+            lg::warn("could not write font cache {}: {}", tmp_path.c_str(), strError(errno));
+            return;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file.get()) == 1
+               && fwrite(ranges.data(), sizeof(Range), ranges.size(), file.get()) == ranges.size()
+               && fwrite(strings.data(), 1, strings.size(), file.get()) == strings.size();
+        if (!ok) {
+            lg::warn("could not write font cache {}: {}", tmp_path.c_str(), strError(errno));
+            return;
+        }
+    }
+    if (rename(tmp_path.c_str(), m_path.c_str()) < 0) {
+        lg::warn("could not replace font cache {}: {}", m_path.c_str(), strError(errno));
+        return;
+    }
+    m_dirty = false;
+}
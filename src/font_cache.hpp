@@ -0,0 +1,89 @@
+#ifndef DWM_FONT_CACHE_HPP
+#define DWM_FONT_CACHE_HPP
+
+#include <X11/Xft/Xft.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+
+/**
+ * Fallback font resolutions from previous runs.
+ *
+ * Maps codepoint ranges to the font file (and face index) fontconfig chose for them, so that a fallback font can be
+ * opened directly instead of going through `XftFontMatch`. The file is memory mapped and only read on lookup.
+ *
+ * The cache is discarded if the fontconfig configuration files or font directories changed, or if the primary fonts
+ * are different from the ones it was written for.
+ */
+struct FontCache {
+    struct Target {
+        /// Font file to open, `nullptr` if no font can render the codepoint
+        char const *file;
+        int index;
+    };
+private:
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t range_count;
+        std::uint64_t fontconfig_stamp;
+        std::uint64_t fontset_hash;
+        std::uint32_t strings_size;
+        std::uint32_t padding;
+    };
+
+    struct Range {
+        static constexpr std::uint32_t no_file = UINT32_MAX;
+        FcChar32 first;
+        FcChar32 last;
+        /// Offset into the string table
+        std::uint32_t file;
+        std::int32_t index;
+    };
+
+    struct NewEntry {
+        std::string file;
+        int index;
+    };
+
+    std::filesystem::path m_path;
+    std::uint64_t m_fontconfig_stamp;
+    std::uint64_t m_fontset_hash;
+
+    void *m_map = nullptr;
+    std::size_t m_map_size = 0;
+    std::span<Range const> m_ranges;
+    std::span<char const> m_strings;
+
+    std::map<FcChar32, NewEntry> m_new;
+    bool m_dirty = false;
+
+    void load();
+    void unmap() noexcept;
+
+public:
+    FontCache(std::filesystem::path path, std::uint64_t fontset_hash);
+    FontCache(FontCache const &) = delete;
+    FontCache &operator=(FontCache const &) = delete;
+    FontCache(FontCache &&) = delete;
+    FontCache &operator=(FontCache &&) = delete;
+    ~FontCache();
+
+    [[nodiscard]]
+    std::optional<Target> find(FcChar32 codepoint) const;
+
+    /// Remember what fontconfig found for `codepoint`, `file` is `nullptr` if nothing was found
+    void record(FcChar32 codepoint, char const *file, int index);
+
+    /// Drop everything loaded from disk, used if a font from the cache can no longer be opened
+    void invalidate();
+
+    /// Write the cache back to disk if anything was recorded
+    void save();
+};
+
+#endif  // DWM_FONT_CACHE_HPP
@@ -0,0 +1,64 @@
+#include "font_coverage.hpp"
+
+static bool hasChar(FcCharSet const *charset, FcChar32 codepoint) {
+    // NOTE: same as XftCharExists, which treats a font without a charset as not having any characters
+    return charset && FcCharSetHasChar(charset, codepoint);
+}
+
+FontCoverage::Index &FontCoverage::entry(FcChar32 codepoint) {
+    auto &page = m_pages[codepoint >> page_bits];
+    if (!page) {
+        page = std::make_unique<Page>();
+        page->fill(unresolved);
+    }
+    return (*page)[codepoint & (page_size - 1)];
+}
+
+void FontCoverage::addFont(FcCharSet const *charset) {
+    auto const idx = static_cast<Index>(m_charsets.size());
+    m_charsets.push_back(charset);
+
+    // Unresolved entries will pick up the new font when they are looked up, but negative entries have to be checked
+    // now, since the new font may be able to render them.
+    for (std::size_t page_idx = 0; page_idx < m_pages.size(); page_idx++) {
+        if (!m_pages[page_idx]) continue;
+        for (std::size_t i = 0; i < page_size; i++) {
+            auto &e = (*m_pages[page_idx])[i];
+            if (e == no_match && hasChar(charset, static_cast<FcChar32>((page_idx << page_bits) | i))) e = idx;
+        }
+    }
+}
+
+void FontCoverage::removeFont(std::size_t idx) {
+    m_charsets.erase(m_charsets.begin() + static_cast<std::ptrdiff_t>(idx));
+
+    // Negative entries stay valid, removing a font cannot make a codepoint renderable.
+    for (auto &page : m_pages) {
+        if (!page) continue;
+        for (auto &e : *page) {
+            if (e == no_match || e == unresolved) continue;
+            if (e == idx)
+                e = unresolved;
+            else if (e > idx)
+                e--;
+        }
+    }
+}
+
+FontCoverage::Index FontCoverage::find(FcChar32 codepoint) {
+    if (codepoint > max_codepoint) return no_match;
+
+    auto &e = entry(codepoint);
+    if (e != unresolved) return e;
+
+    for (std::size_t i = 0; i < m_charsets.size(); i++)
+        if (hasChar(m_charsets[i], codepoint)) return e = static_cast<Index>(i);
+
+    // Not cached: a fallback font may be added for it, in which case the next lookup has to find it.
+    return missing;
+}
+
+void FontCoverage::markNoMatch(FcChar32 codepoint) {
+    if (codepoint > max_codepoint) return;
+    entry(codepoint) = no_match;
+}
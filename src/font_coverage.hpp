@@ -0,0 +1,62 @@
+#ifndef DWM_FONT_COVERAGE_HPP
+#define DWM_FONT_COVERAGE_HPP
+
+#include <X11/Xft/Xft.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Maps codepoints to the index of the first loaded font which can render them.
+ *
+ * The table is split into 256 codepoint pages which are only allocated once a codepoint from that page is looked up.
+ * Entries are resolved lazily against the `FcCharSet` of every registered font (in registration order, same as
+ * `Drw::m_fonts`).
+ *
+ * Codepoints which no font (including fallback fonts found by fontconfig) can render are recorded with `markNoMatch`
+ * and stay in the table, so there is no limit on how many of them are remembered.
+ */
+struct FontCoverage {
+    using Index = std::uint16_t;
+
+    /// No registered font has this codepoint, the caller should look for a fallback font.
+    static constexpr Index missing = 0xFFFE;
+    /// Nothing can render this codepoint, it has been recorded with `markNoMatch`.
+    static constexpr Index no_match = 0xFFFF;
+private:
+    static constexpr Index unresolved = 0xFFFD;
+    static constexpr std::size_t max_fonts = unresolved;
+    static constexpr std::size_t page_bits = 8;
+    static constexpr std::size_t page_size = 1uz << page_bits;
+    static constexpr FcChar32 max_codepoint = 0x10FFFF;
+    static constexpr std::size_t page_count = (max_codepoint >> page_bits) + 1;
+
+    using Page = std::array<Index, page_size>;
+
+    std::vector<FcCharSet const *> m_charsets;
+    std::vector<std::unique_ptr<Page>> m_pages = std::vector<std::unique_ptr<Page>>(page_count);
+
+    Index &entry(FcChar32 codepoint);
+
+public:
+    /// Register the next font. Fonts have to be added in the same order they are stored in.
+    void addFont(FcCharSet const *charset);
+
+    /// Unregister the font at `idx`. Fonts after it move down by one, the same as erasing it from `Drw::m_fonts`.
+    void removeFont(std::size_t idx);
+
+    /// Index of the first font which has `codepoint`, `missing` or `no_match`.
+    [[nodiscard]]
+    Index find(FcChar32 codepoint);
+
+    void markNoMatch(FcChar32 codepoint);
+
+    [[nodiscard]]
+    bool full() const {
+        return m_charsets.size() >= max_fonts;
+    }
+};
+
+#endif  // DWM_FONT_COVERAGE_HPP
@@ -3,16 +3,35 @@
 
 
 #include <memory>
+#include <span>
 struct Monitor;
+struct Client;
+
+/// Visible tiled clients of a monitor in list order, collected once per arrange
+struct TiledClients {
+    std::span<Client *const> clients;
+    /// Monocle or a single client: windows are placed without gaps and borders
+    bool gapless;
+};
+
+/// What happens to tiled clients covered by the monocle or a fullscreen client
+enum class Occluded {
+    /// Nothing, they stay mapped underneath
+    keep,
+    /// Moved off-screen like clients on hidden tags
+    park,
+    /// Unmapped and put into IconicState
+    iconify,
+};
 
 struct Layout {
     char const *symbol;
-    void (*arrange)(struct std::shared_ptr<Monitor> const &);
+    void (*arrange)(struct std::shared_ptr<Monitor> const &, TiledClients const &);
 };
 
-void tile(struct std::shared_ptr<Monitor> const &);
-void monocle(struct std::shared_ptr<Monitor> const &);
-void centeredmaster(struct std::shared_ptr<Monitor> const &);
-void centeredfloatingmaster(struct std::shared_ptr<Monitor> const &);
+void tile(struct std::shared_ptr<Monitor> const &, TiledClients const &);
+void monocle(struct std::shared_ptr<Monitor> const &, TiledClients const &);
+void centeredmaster(struct std::shared_ptr<Monitor> const &, TiledClients const &);
+void centeredfloatingmaster(struct std::shared_ptr<Monitor> const &, TiledClients const &);
 
 #endif  // DWM_LAYOUT_HPP
@@ -0,0 +1,23 @@
+#include "raster.hpp"
+
+bool rasterIsAvailable() {
+    return false;
+}
+
+RasterImage::~RasterImage() = default;
+
+void RasterImage::free() noexcept { }
+
+std::optional<RasterImage> RasterImage::create(Display *, int, unsigned int, unsigned int) {
+    return std::nullopt;
+}
+
+void RasterImage::fill(XRectangle, unsigned long) { }
+
+void RasterImage::outline(XRectangle, unsigned long) { }
+
+void RasterImage::drawText(XftFont *, XftColor const &, int, int, std::string_view) { }
+
+void RasterImage::put(Window, GC, int, int, unsigned int, unsigned int) { }
+
+void rasterFontClosed(XftFont *) { }
@@ -4,6 +4,12 @@ bool xineramaIsActive(Display *) {
     return false;
 }
 
+std::vector<int> selectScreenChanges(Display *, Window) {
+    return {};
+}
+
+void screenChanged(XEvent *) { }
+
 ScreenInfoPtr::~ScreenInfoPtr() = default;
 
 ScreenInfo ScreenInfoPtr::operator[](std::size_t) const noexcept {
@@ -0,0 +1,21 @@
+#include "xsync.hpp"
+
+std::optional<int> syncInit(Display *) {
+    return std::nullopt;
+}
+
+std::optional<std::uint64_t> syncCounterValue(Display *, XID) {
+    return std::nullopt;
+}
+
+void syncSetAlarm(Display *, XID &, XID, std::uint64_t) { }
+
+void syncDestroyAlarm(Display *, XID) { }
+
+bool syncIsCounterError(XErrorEvent const *) {
+    return false;
+}
+
+SyncAlarmNotify syncAlarmNotify(XEvent *) {
+    return {.alarm = None, .value = 0};
+}
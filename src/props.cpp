@@ -5,6 +5,7 @@
 
 #include <X11/Xatom.h>
 
+#include <algorithm>
 #include <limits>
 #include <ranges>
 #include <utility>
@@ -13,27 +14,79 @@
 
 static constexpr auto UINT32_FORMAT = 32;
 
-void setCardinalProp(Display *dpy, Client *c, Atom prop, std::uint32_t value) {
-    setCardinalProps(dpy, c, prop, std::array {value});
+unsigned char *PropWriter::Write::data() {
+    return reinterpret_cast<unsigned char *>(is_large ? large.data() : small.data());
 }
 
-void setCardinalProps(Display *dpy, Client *c, Atom prop, std::span<std::uint32_t const> values) {
+PropWriter::Write &PropWriter::find(Window win, Atom prop) {
+    /* only a handful of writes pile up between flushes */
+    for (auto &write : m_pending)
+        if (write.win == win && write.prop == prop) return write;
+    return m_pending.emplace_back(Write {
+        .win = win,
+        .prop = prop,
+        .type = None,
+        .format = 0,
+        .remove = false,
+        .nitems = 0,
+        .is_large = false,
+        .small = {},
+        .large = {},
+    });
+}
+
+unsigned char *PropWriter::stage(Window win, Atom prop, Atom type, int format, std::size_t nitems) {
+    auto &write = find(win, prop);
+    write.type = type;
+    write.format = format;
+    write.remove = false;
+    write.nitems = nitems;
+    auto const bytes = format == 32 ? nitems * sizeof(long) : nitems * static_cast<std::size_t>(format / 8);
+    auto const longs = (bytes + sizeof(long) - 1) / sizeof(long);
+    write.is_large = longs > inline_longs;
+    if (write.is_large) write.large.resize(longs);
+    return write.data();
+}
+
+void PropWriter::set8(Window win, Atom prop, Atom type, std::string_view value) {
+    std::ranges::copy(value, stage(win, prop, type, 8, value.size()));
+}
+
+void PropWriter::remove(Window win, Atom prop) {
+    find(win, prop).remove = true;
+}
+
+void PropWriter::flush(Display *dpy) {
+    for (auto &write : m_pending) {
+        if (write.remove) {
+            XDeleteProperty(dpy, write.win, write.prop);
+        } else if (std::in_range<int>(write.nitems)) {
+            XChangeProperty(dpy,
+                write.win,
+                write.prop,
+                write.type,
+                write.format,
+                PropModeReplace,
+                write.data(),
+                static_cast<int>(write.nitems));
+        } else {
+            lg::error("Cannot set {} items, length out of range", write.nitems);
+        }
+    }
+    m_pending.clear();
+}
+
+void setCardinalProp(PropWriter &writer, Client *c, Atom prop, std::uint32_t value) {
+    setCardinalProps(writer, c, prop, std::array {value});
+}
+
+void setCardinalProps(PropWriter &writer, Client *c, Atom prop, std::span<std::uint32_t const> values) {
     if (prop == None) return;
-    if (values.size() == 0 || !std::in_range<int>(values.size())) {
+    if (values.size() == 0) {
         lg::error("Cannot set {} CARDINALS, length out of range", values.size());
         return;
     }
-    // static constexpr auto
-    std::vector<unsigned long> new_data;
-    new_data.resize(values.size());
-    for (std::size_t i = 0; i < new_data.size(); ++i)
-        new_data[i] = values[i];
-
-    auto const *data = reinterpret_cast<unsigned char const *>(new_data.data());
-    auto const nelements = static_cast<int>(values.size());
-
-    XChangeProperty(dpy, c->win, prop, XA_CARDINAL, UINT32_FORMAT, PropModeReplace, data, nelements);
-    XSync(dpy, False);
+    writer.set32(c->win, prop, XA_CARDINAL, values);
 }
 
 static std::expected<std::vector<uint32_t>, int> getCardinalPropImpl(
@@ -3,14 +3,71 @@
 
 #include "dwm.hpp"
 
+#include <array>
 #include <cstdint>
 #include <expected>
+#include <ranges>
 #include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * The single path for changing window properties.
+ *
+ * Writes are only recorded, `flush` sends them (the event loop does it once per tick) without waiting for the server.
+ * A write to a window property which is still pending replaces the old value, so values the server would overwrite
+ * straight away are never sent.
+ */
+struct PropWriter {
+private:
+    /// Values of up to this many longs are stored without allocating
+    static constexpr std::size_t inline_longs = 4;
+
+    struct Write {
+        Window win;
+        Atom prop;
+        Atom type;
+        int format;
+        /// XDeleteProperty rather than XChangeProperty
+        bool remove;
+        std::size_t nitems;
+        bool is_large;
+        std::array<long, inline_longs> small;
+        std::vector<long> large;
+
+        [[nodiscard]]
+        unsigned char *data();
+    };
+
+    std::vector<Write> m_pending;
+
+    Write &find(Window win, Atom prop);
+    /// Storage for `nitems` items of `format` bits (32 bit items are longs, as Xlib wants them)
+    unsigned char *stage(Window win, Atom prop, Atom type, int format, std::size_t nitems);
+
+public:
+    template<std::ranges::sized_range R>
+    void set32(Window win, Atom prop, Atom type, R const &values) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto *out = reinterpret_cast<long *>(stage(win, prop, type, 32, std::ranges::size(values)));
+        for (auto const &value : values)
+            *out++ = static_cast<long>(value);
+    }
+
+    void set8(Window win, Atom prop, Atom type, std::string_view value);
+    void remove(Window win, Atom prop);
+    void flush(Display *dpy);
+
+    [[nodiscard]]
+    std::size_t pending() const {
+        return m_pending.size();
+    }
+};
 
 // TODO(dk949): Make sure to move all other prop getters here
 
-void setCardinalProp(Display *dpy, Client *c, Atom prop, std::uint32_t value);
-void setCardinalProps(Display *dpy, Client *c, Atom prop, std::span<std::uint32_t const> values);
+void setCardinalProp(PropWriter &writer, Client *c, Atom prop, std::uint32_t value);
+void setCardinalProps(PropWriter &writer, Client *c, Atom prop, std::span<std::uint32_t const> values);
 std::expected<uint32_t, int> getCardinalProp(Display *dpy, Client *c, Atom prop);
 std::expected<std::vector<uint32_t>, int> getCardinalProp(Display *dpy, Client *c, Atom prop, std::size_t count);
 std::expected<std::vector<uint32_t>, int> getCardinalProps(Display *dpy, Client *c, Atom prop);
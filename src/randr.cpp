@@ -0,0 +1,74 @@
+#include "xinerama.hpp"
+
+#include "log.hpp"
+
+#include <X11/extensions/Xrandr.h>
+#include <X11/Xlib.h>
+
+#include <optional>
+
+static int event_base = 0;
+
+bool xineramaIsActive(Display *dpy) {
+    /* asked on every geometry update, the answer does not change while the server is running */
+    static std::optional<bool> active;
+    if (active) return *active;
+
+    int error_base = 0;
+    int major = 0;
+    int minor = 0;
+    if (!XRRQueryExtension(dpy, &event_base, &error_base) || !XRRQueryVersion(dpy, &major, &minor)) {
+        lg::warn("RandR is not available, using a single screen");
+        active = false;
+    } else if (major < 1 || (major == 1 && minor < 5)) {
+        /* monitors were added in 1.5 */
+        lg::warn("RandR {}.{} is too old, using a single screen", major, minor);
+        active = false;
+    } else {
+        active = true;
+    }
+    return *active;
+}
+
+std::vector<int> selectScreenChanges(Display *dpy, Window root) {
+    if (!xineramaIsActive(dpy)) return {};
+    XRRSelectInput(dpy, root, RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+    /* crtc and output changes all come as RRNotify */
+    return {event_base + RRScreenChangeNotify, event_base + RRNotify};
+}
+
+void screenChanged(XEvent *ev) {
+    /* ignores anything other than RRScreenChangeNotify and root ConfigureNotify */
+    XRRUpdateConfiguration(ev);
+}
+
+ScreenInfoPtr::~ScreenInfoPtr() {
+    free();
+}
+
+ScreenInfo ScreenInfoPtr::operator[](std::size_t idx) const noexcept {
+    if (!m_infos) {
+        lg::error("Trying to index ScreenInfo with no RandR monitors!");
+        return {};
+    }
+    auto const *infos = static_cast<XRRMonitorInfo const *>(m_infos);
+    return {
+        .screen_number = static_cast<int>(idx),
+        .x_org = static_cast<short>(infos[idx].x),
+        .y_org = static_cast<short>(infos[idx].y),
+        .width = static_cast<short>(infos[idx].width),
+        .height = static_cast<short>(infos[idx].height),
+        .id = infos[idx].name,
+    };
+}
+
+void ScreenInfoPtr::free() noexcept {
+    if (m_infos) XRRFreeMonitors(static_cast<XRRMonitorInfo *>(m_infos));
+}
+
+ScreenInfoPtr ScreenInfoPtr::query(Display *dpy) {
+    int count = 0;
+    /* active monitors only, disabled outputs are not screens */
+    auto *infos = XRRGetMonitors(dpy, DefaultRootWindow(dpy), True, &count);
+    return ScreenInfoPtr {dpy, infos, count};
+}
@@ -0,0 +1,396 @@
+#include "raster.hpp"
+
+#include "log.hpp"
+#include "strerror.hpp"
+#include "utf8.hpp"
+
+#include <X11/extensions/XShm.h>
+#include <X11/Xutil.h>
+#include <ft2build.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __SSE2__
+#    include <emmintrin.h>
+#endif
+
+bool rasterIsAvailable() {
+    return true;
+}
+
+struct RasterGlyph {
+    /// Coverage of every pixel, or premultiplied BGRA for color glyphs (emoji)
+    std::vector<std::uint8_t> bitmap;
+    int left = 0;
+    int top = 0;
+    unsigned w = 0;
+    unsigned h = 0;
+    int advance = 0;
+    bool color = false;
+};
+
+/* Glyphs rendered from one font, capped like Xft's own glyph cache so fallback fonts stay within their budget */
+struct FontGlyphs {
+    std::unordered_map<FT_UInt, RasterGlyph> glyphs;
+    std::size_t memory = 0;
+    std::size_t limit = 0;
+};
+
+/* Glyphs are rendered once per font and kept until the font is closed or its cache is full */
+static std::unordered_map<XftFont *, FontGlyphs> glyph_cache;
+
+/* same as XFT_FONT_MAX_GLYPH_MEMORY, used if the pattern does not set XFT_MAX_GLYPH_MEMORY */
+static constexpr int default_glyph_memory = 1024 * 1024;
+
+/// FreeType load flags matching the rendering settings fontconfig chose for `font`. Subpixel rendering is not
+/// supported, text is always antialiased in grayscale.
+static FT_Int32 loadFlags(XftFont *font) {
+    FcBool antialias = FcTrue;
+    FcBool hinting = FcTrue;
+    FcBool autohint = FcFalse;
+    int hintstyle = FC_HINT_FULL;
+    FcPatternGetBool(font->pattern, FC_ANTIALIAS, 0, &antialias);
+    FcPatternGetBool(font->pattern, FC_HINTING, 0, &hinting);
+    FcPatternGetBool(font->pattern, FC_AUTOHINT, 0, &autohint);
+    FcPatternGetInteger(font->pattern, FC_HINT_STYLE, 0, &hintstyle);
+
+    FT_Int32 flags = FT_LOAD_RENDER | FT_LOAD_COLOR;
+    if (!antialias)
+        flags |= FT_LOAD_TARGET_MONO;
+    else if (hintstyle <= FC_HINT_SLIGHT)
+        flags |= FT_LOAD_TARGET_LIGHT;
+    if (!hinting || hintstyle == FC_HINT_NONE) flags |= FT_LOAD_NO_HINTING;
+    if (autohint) flags |= FT_LOAD_FORCE_AUTOHINT;
+    return flags;
+}
+
+/// Scale a color bitmap strike (e.g. a 109px emoji) down by `scale`, averaging the premultiplied pixels of each box
+static void scaleColorGlyph(RasterGlyph &glyph, double scale) {
+    auto w = std::max(1u, (unsigned)std::lround(glyph.w * scale));
+    auto h = std::max(1u, (unsigned)std::lround(glyph.h * scale));
+    std::vector<std::uint8_t> out((std::size_t)w * h * 4);
+    auto src_begin = [](unsigned dst, unsigned dst_size, unsigned src_size) {
+        return (unsigned)((std::uint64_t)dst * src_size / dst_size);
+    };
+    for (unsigned y = 0; y < h; y++) {
+        auto y0 = src_begin(y, h, glyph.h);
+        auto y1 = std::max(y0 + 1, src_begin(y + 1, h, glyph.h));
+        for (unsigned x = 0; x < w; x++) {
+            auto x0 = src_begin(x, w, glyph.w);
+            auto x1 = std::max(x0 + 1, src_begin(x + 1, w, glyph.w));
+            std::array<unsigned, 4> sum {};
+            for (auto sy = y0; sy < y1; sy++)
+                for (auto sx = x0; sx < x1; sx++)
+                    for (std::size_t c = 0; c < 4; c++)
+                        sum[c] += glyph.bitmap[((std::size_t)sy * glyph.w + sx) * 4 + c];
+            auto count = (y1 - y0) * (x1 - x0);
+            for (std::size_t c = 0; c < 4; c++)
+                out[((std::size_t)y * w + x) * 4 + c] = (std::uint8_t)((sum[c] + count / 2) / count);
+        }
+    }
+    glyph.bitmap = std::move(out);
+    glyph.w = w;
+    glyph.h = h;
+    glyph.left = (int)std::lround(glyph.left * scale);
+    glyph.top = (int)std::lround(glyph.top * scale);
+    glyph.advance = (int)std::lround(glyph.advance * scale);
+}
+
+static RasterGlyph const &loadGlyph(XftFont *font, FT_Face face, FT_UInt index) {
+    auto &cache = glyph_cache[font];
+    if (auto it = cache.glyphs.find(index); it != cache.glyphs.end()) return it->second;
+    if (!cache.limit) {
+        int limit = default_glyph_memory;
+        FcPatternGetInteger(font->pattern, XFT_MAX_GLYPH_MEMORY, 0, &limit);
+        cache.limit = (std::size_t)std::max(limit, 1);
+    }
+
+    RasterGlyph glyph;
+    if (FT_Load_Glyph(face, index, loadFlags(font)) == 0) {
+        auto const *slot = face->glyph;
+        auto const &bitmap = slot->bitmap;
+        glyph.left = slot->bitmap_left;
+        glyph.top = slot->bitmap_top;
+        glyph.advance = (int)((slot->advance.x + 32) >> 6);
+        glyph.w = bitmap.width;
+        glyph.h = bitmap.rows;
+
+        auto row = [&](unsigned y) {
+            auto pitch = (std::ptrdiff_t)bitmap.pitch;
+            /* with a negative pitch the bottom row comes first */
+            return bitmap.buffer + (pitch < 0 ? (std::ptrdiff_t)(glyph.h - 1 - y) * -pitch : (std::ptrdiff_t)y * pitch);
+        };
+        switch (bitmap.pixel_mode) {
+            case FT_PIXEL_MODE_GRAY:
+                glyph.bitmap.resize((std::size_t)glyph.w * glyph.h);
+                for (unsigned y = 0; y < glyph.h; y++)
+                    std::memcpy(glyph.bitmap.data() + (std::size_t)y * glyph.w, row(y), glyph.w);
+                break;
+            case FT_PIXEL_MODE_MONO:
+                glyph.bitmap.resize((std::size_t)glyph.w * glyph.h);
+                for (unsigned y = 0; y < glyph.h; y++)
+                    for (unsigned x = 0; x < glyph.w; x++)
+                        glyph.bitmap[(std::size_t)y * glyph.w + x] = (row(y)[x / 8] & (0x80 >> (x % 8))) ? 0xFF : 0;
+                break;
+            case FT_PIXEL_MODE_BGRA:
+                glyph.color = true;
+                glyph.bitmap.resize((std::size_t)glyph.w * glyph.h * 4);
+                for (unsigned y = 0; y < glyph.h; y++)
+                    std::memcpy(glyph.bitmap.data() + (std::size_t)y * glyph.w * 4, row(y), (std::size_t)glyph.w * 4);
+                break;
+            default:
+                glyph.w = glyph.h = 0;
+                break;
+        }
+        /* Color fonts usually only have fixed size strikes, Xft scales them to the requested size, and so has this to
+         * match the advances the text was measured with */
+        double pixel_size = 0;
+        if (glyph.color && !FT_IS_SCALABLE(face) && face->size->metrics.y_ppem
+            && FcPatternGetDouble(font->pattern, FC_PIXEL_SIZE, 0, &pixel_size) == FcResultMatch
+            && pixel_size < face->size->metrics.y_ppem)
+            scaleColorGlyph(glyph, pixel_size / face->size->metrics.y_ppem);
+    }
+
+    auto memory = sizeof(RasterGlyph) + glyph.bitmap.size();
+    if (cache.memory + memory > cache.limit) {
+        /* nothing refers to the cached glyphs between two loads, so starting over is safe */
+        cache.glyphs.clear();
+        cache.memory = 0;
+    }
+    cache.memory += memory;
+    return cache.glyphs.emplace(index, std::move(glyph)).first->second;
+}
+
+void rasterFontClosed(XftFont *font) {
+    glyph_cache.erase(font);
+}
+
+/// (s * a + d * (255 - a)) / 255 for every channel, rounded. Exact for 8 bit values, without a division.
+static inline std::uint32_t blendPixel(std::uint32_t dst, std::uint32_t src, std::uint32_t alpha) {
+    std::uint32_t out = 0;
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        auto t = ((src >> shift) & 0xFF) * alpha + ((dst >> shift) & 0xFF) * (255 - alpha) + 128;
+        out |= ((t + (t >> 8)) >> 8) << shift;
+    }
+    return out;
+}
+
+#ifdef __SSE2__
+static void blendRow(std::uint32_t *dst, std::uint8_t const *coverage, std::size_t n, std::uint32_t color) {
+    auto const zero = _mm_setzero_si128();
+    auto const src = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    auto const max = _mm_set1_epi16(255);
+    auto const round = _mm_set1_epi16(128);
+    /* two pixels with 16 bits per channel, the products fit into 16 bits unsigned */
+    auto blend = [&](__m128i d, __m128i a) {
+        auto t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(src, a), _mm_mullo_epi16(d, _mm_sub_epi16(max, a))),
+            round);
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    };
+
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        std::uint32_t alpha;
+        std::memcpy(&alpha, coverage + i, sizeof(alpha));
+        if (!alpha) continue;
+        /* spread the coverage of each pixel over its 4 channels */
+        auto a = _mm_cvtsi32_si128((int)alpha);
+        a = _mm_unpacklo_epi8(a, a);
+        a = _mm_unpacklo_epi16(a, a);
+        auto d = _mm_loadu_si128(reinterpret_cast<__m128i const *>(dst + i));
+        auto lo = blend(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(a, zero));
+        auto hi = blend(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(a, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < n; i++)
+        if (coverage[i]) dst[i] = blendPixel(dst[i], color, coverage[i]);
+}
+#else
+static void blendRow(std::uint32_t *dst, std::uint8_t const *coverage, std::size_t n, std::uint32_t color) {
+    for (std::size_t i = 0; i < n; i++)
+        if (coverage[i]) dst[i] = blendPixel(dst[i], color, coverage[i]);
+}
+#endif
+
+/// `src` is premultiplied BGRA
+static void blendColorRow(std::uint32_t *dst, std::uint8_t const *src, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++, src += 4) {
+        std::uint32_t alpha = src[3];
+        if (!alpha) continue;
+        auto color = (std::uint32_t)src[0] | (std::uint32_t)src[1] << 8 | (std::uint32_t)src[2] << 16;
+        /* the color is premultiplied, only the destination has to be scaled by 1 - alpha */
+        dst[i] = (color + blendPixel(dst[i] & 0xFFFFFF, 0, alpha)) | (dst[i] & 0xFF000000);
+    }
+}
+
+static std::uint32_t *pixelRow(XImage *image, int y) {
+    return reinterpret_cast<std::uint32_t *>(image->data + (std::ptrdiff_t)y * image->bytes_per_line);
+}
+
+/// [begin, begin + len) clipped to [0, size)
+static std::pair<int, int> clipSpan(int begin, int len, int size) {
+    return {std::clamp(begin, 0, size), std::clamp(begin + len, 0, size)};
+}
+
+static void drawGlyph(XImage *image, RasterGlyph const &glyph, int x, int y, std::uint32_t pixel) {
+    auto [x0, x1] = clipSpan(x, (int)glyph.w, image->width);
+    auto [y0, y1] = clipSpan(y, (int)glyph.h, image->height);
+    if (x0 >= x1) return;
+    auto n = (std::size_t)(x1 - x0);
+    for (int row = y0; row < y1; row++) {
+        auto offset = (std::size_t)(row - y) * glyph.w + (std::size_t)(x0 - x);
+        if (glyph.color)
+            blendColorRow(pixelRow(image, row) + x0, glyph.bitmap.data() + offset * 4, n);
+        else
+            blendRow(pixelRow(image, row) + x0, glyph.bitmap.data() + offset, n, pixel);
+    }
+}
+
+void RasterImage::fill(XRectangle rect, unsigned long pixel) {
+    auto [x0, x1] = clipSpan(rect.x, rect.width, m_image->width);
+    auto [y0, y1] = clipSpan(rect.y, rect.height, m_image->height);
+    for (int y = y0; y < y1; y++)
+        std::fill(pixelRow(m_image, y) + x0, pixelRow(m_image, y) + x1, (std::uint32_t)pixel);
+}
+
+void RasterImage::outline(XRectangle rect, unsigned long pixel) {
+    if (!rect.width || !rect.height) return;
+    fill({rect.x, rect.y, rect.width, 1}, pixel);
+    fill({rect.x, (short)(rect.y + rect.height - 1), rect.width, 1}, pixel);
+    fill({rect.x, rect.y, 1, rect.height}, pixel);
+    fill({(short)(rect.x + rect.width - 1), rect.y, 1, rect.height}, pixel);
+}
+
+void RasterImage::drawText(XftFont *font, XftColor const &color, int x, int y, std::string_view text) {
+    FT_Face face = XftLockFace(font);
+    if (!face) return;
+
+    std::vector<utf8::Codepoint> codepoints;
+    utf8::decode(text, codepoints);
+    for (auto codepoint : codepoints) {
+        auto const &glyph = loadGlyph(font, face, XftCharIndex(m_dpy, font, codepoint.value));
+        drawGlyph(m_image, glyph, x + glyph.left, y - glyph.top, (std::uint32_t)color.pixel);
+        x += glyph.advance;
+    }
+    XftUnlockFace(font);
+}
+
+void RasterImage::put(Window win, GC gc, int x, int y, unsigned int w, unsigned int h) {
+    if (m_shm)
+        XShmPutImage(m_dpy, win, gc, m_image, x, y, x, y, w, h, False);
+    else
+        XPutImage(m_dpy, win, gc, m_image, x, y, x, y, w, h);
+}
+
+static bool shm_failed = false;
+
+static int shmErrorHandler(Display *, XErrorEvent *) {
+    shm_failed = true;
+    return 0;
+}
+
+/// Pixels are written as native 32 bit integers
+static bool usable(XImage const *image) {
+    static constexpr int native_byte_order = std::endian::native == std::endian::little ? LSBFirst : MSBFirst;
+    return image->bits_per_pixel == 32 && image->byte_order == native_byte_order;
+}
+
+static XImage *createShmImage(Display *dpy, Visual *visual, unsigned int depth, unsigned int w, unsigned int h,
+    XShmSegmentInfo *shm) {
+    if (!XShmQueryExtension(dpy)) return nullptr;
+    auto *image = XShmCreateImage(dpy, visual, depth, ZPixmap, nullptr, shm, w, h);
+    if (!image) return nullptr;
+    if (!usable(image)) {
+        XDestroyImage(image);
+        return nullptr;
+    }
+
+    shm->shmid = shmget(IPC_PRIVATE, (std::size_t)image->bytes_per_line * h, IPC_CREAT | 0600);
+    if (shm->shmid < 0) {
+        lg::warn("could not allocate shared memory for the bar: {}", strError(errno));
+        XDestroyImage(image);
+        return nullptr;
+    }
+    shm->shmaddr = static_cast<char *>(shmat(shm->shmid, nullptr, 0));
+    shm->readOnly = False;
+
+    bool attached = false;
+    if (shm->shmaddr != reinterpret_cast<char *>(-1)) {
+        /* attaching fails asynchronously if the server cannot access the segment, e.g. on a remote display */
+        shm_failed = false;
+        auto *old_handler = XSetErrorHandler(shmErrorHandler);
+        XShmAttach(dpy, shm);
+        XSync(dpy, False);
+        XSetErrorHandler(old_handler);
+        attached = !shm_failed;
+        if (!attached) shmdt(shm->shmaddr);
+    }
+    /* the segment is destroyed once both dwm and the server have detached from it */
+    shmctl(shm->shmid, IPC_RMID, nullptr);
+    if (!attached) {
+        XDestroyImage(image);
+        return nullptr;
+    }
+    image->data = shm->shmaddr;
+    return image;
+}
+
+std::optional<RasterImage> RasterImage::create(Display *dpy, int screen, unsigned int w, unsigned int h) {
+    auto *visual = DefaultVisual(dpy, screen);
+    auto depth = (unsigned)DefaultDepth(dpy, screen);
+    if (visual->c_class != TrueColor || visual->red_mask != 0xFF0000 || visual->green_mask != 0xFF00
+        || visual->blue_mask != 0xFF) {
+        static bool warned = false;
+        if (!std::exchange(warned, true)) lg::warn("visual is not 8 bit TrueColor, not rasterizing the bar");
+        return std::nullopt;
+    }
+
+    auto shm = std::make_unique<XShmSegmentInfo>();
+    if (auto *image = createShmImage(dpy, visual, depth, w, h, shm.get())) return RasterImage {dpy, image, shm.release()};
+
+    auto *image = XCreateImage(dpy, visual, depth, ZPixmap, 0, nullptr, w, h, 32, 0);
+    if (!image) return std::nullopt;
+    if (!usable(image)) {
+        XDestroyImage(image);
+        return std::nullopt;
+    }
+    /* released by XDestroyImage */
+    image->data = static_cast<char *>(std::calloc((std::size_t)image->bytes_per_line, h));
+    if (!image->data) {
+        XDestroyImage(image);
+        return std::nullopt;
+    }
+    return RasterImage {dpy, image, nullptr};
+}
+
+void RasterImage::free() noexcept {
+    if (!m_image) return;
+    if (auto *shm = static_cast<XShmSegmentInfo *>(std::exchange(m_shm, nullptr))) {
+        XShmDetach(m_dpy, shm);
+        /* the data belongs to the segment */
+        m_image->data = nullptr;
+        XDestroyImage(m_image);
+        shmdt(shm->shmaddr);
+        delete shm;
+    } else {
+        XDestroyImage(m_image);
+    }
+    m_image = nullptr;
+}
+
+RasterImage::~RasterImage() {
+    free();
+}
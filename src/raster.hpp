@@ -0,0 +1,74 @@
+#ifndef DWM_RASTER_HPP
+#define DWM_RASTER_HPP
+
+#include <X11/Xft/Xft.h>
+#include <X11/Xlib.h>
+
+#include <optional>
+#include <string_view>
+#include <utility>
+
+/// Whether dwm was built with the client side bar renderer (`RASTER_BAR`)
+bool rasterIsAvailable();
+
+/**
+ * Client side image of a bar.
+ *
+ * Rectangles and text are rasterized into memory (text with FreeType, through the face of the Xft font) and the
+ * result is uploaded to the window with a single `XShmPutImage`, or `XPutImage` if MIT-SHM is not usable (e.g. on a
+ * remote display). Only TrueColor visuals with 8 bit channels are supported, `create` returns nothing otherwise.
+ */
+struct RasterImage {
+private:
+    Display *m_dpy = nullptr;
+    XImage *m_image = nullptr;
+    /// `XShmSegmentInfo`, `nullptr` if the image is not in shared memory
+    void *m_shm = nullptr;
+    void free() noexcept;
+
+    RasterImage(Display *dpy, XImage *image, void *shm)
+            : m_dpy(dpy)
+            , m_image(image)
+            , m_shm(shm) { }
+public:
+    ~RasterImage();
+
+    RasterImage(RasterImage const &) = delete;
+    RasterImage &operator=(RasterImage const &) = delete;
+
+    RasterImage(RasterImage &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    RasterImage &operator=(RasterImage &&other) noexcept {
+        if (this != &other) {
+            free();
+            m_dpy = other.m_dpy;
+            m_image = std::exchange(other.m_image, nullptr);
+            m_shm = std::exchange(other.m_shm, nullptr);
+        }
+        return *this;
+    }
+
+    [[nodiscard]]
+    static std::optional<RasterImage> create(Display *dpy, int screen, unsigned int w, unsigned int h);
+
+    void fill(XRectangle rect, unsigned long pixel);
+    /// 1 pixel wide outline inside of `rect`, same as `XDrawRectangle(x, y, w - 1, h - 1)`
+    void outline(XRectangle rect, unsigned long pixel);
+    /// Draw UTF-8 `text` with its baseline starting at `x`, `y`
+    void drawText(XftFont *font, XftColor const &color, int x, int y, std::string_view text);
+
+    /**
+     * Copy [x, x + w) x [y, y + h) to the same area of `win`.
+     *
+     * The server reads shared memory asynchronously, nothing may be drawn into the image until it has processed the
+     * request (e.g. after `XSync`).
+     */
+    void put(Window win, GC gc, int x, int y, unsigned int w, unsigned int h);
+};
+
+/// Drop glyphs rendered from `font`, has to be called before the font is closed
+void rasterFontClosed(XftFont *font);
+
+#endif  // DWM_RASTER_HPP
@@ -0,0 +1,91 @@
+#include "status.hpp"
+
+#include "util.hpp"
+
+#include <charconv>
+
+static std::optional<std::uint32_t> parseRgb(std::string_view text) {
+    if (text.size() != 7 || text[0] != '#') return std::nullopt;
+    std::uint32_t rgb = 0;
+    auto [end, ec] = std::from_chars(text.data() + 1, text.data() + text.size(), rgb, 16);
+    if (ec != std::errc {} || end != text.data() + text.size()) return std::nullopt;
+    return rgb;
+}
+
+static bool sameStyle(StatusText::Segment const &a, StatusText::Segment const &b) {
+    return a.scheme == b.scheme && a.fg == b.fg && a.bg == b.bg;
+}
+
+std::vector<StatusText::Segment> StatusText::parse(std::string_view text) {
+    std::vector<Segment> out(1);
+
+    /* a style change starts a new segment, unless nothing has been written with the current style yet */
+    auto restyle = [&]() -> Segment & {
+        if (!out.back().text.empty()) {
+            auto const &last = out.back();
+            out.push_back({.text = {}, .scheme = last.scheme, .fg = last.fg, .bg = last.bg});
+        }
+        return out.back();
+    };
+
+    while (!text.empty()) {
+        auto caret = text.find('^');
+        out.back().text.append(text.substr(0, caret));
+        if (caret == std::string_view::npos) break;
+        text.remove_prefix(caret);
+
+        if (text.starts_with("^^")) {
+            out.back().text.push_back('^');
+            text.remove_prefix(2);
+            continue;
+        }
+        auto end = text.find('^', 1);
+        auto escape = text.substr(1, end == std::string_view::npos ? 0 : end - 1);
+        bool valid = true;
+        if (escape == "d") {
+            auto &seg = restyle();
+            seg.scheme.clear();
+            seg.fg = seg.bg = std::nullopt;
+        } else if (escape.size() > 1 && escape[0] == 's') {
+            auto &seg = restyle();
+            seg.scheme = escape.substr(1);
+            seg.fg = seg.bg = std::nullopt;
+        } else if (auto rgb = escape.empty() ? std::nullopt : parseRgb(escape.substr(1));
+                   rgb && (escape[0] == 'c' || escape[0] == 'b')) {
+            auto &seg = restyle();
+            (escape[0] == 'c' ? seg.fg : seg.bg) = rgb;
+        } else {
+            valid = false;
+        }
+
+        if (valid) {
+            text.remove_prefix(end + 1);
+        } else {
+            /* not an escape, draw the caret and carry on after it */
+            out.back().text.push_back('^');
+            text.remove_prefix(1);
+        }
+    }
+
+    /* escapes which did not change anything or were not followed by any text leave behind segments to merge */
+    std::vector<Segment> merged;
+    merged.reserve(out.size());
+    for (auto &seg : out) {
+        if (seg.text.empty()) continue;
+        if (!merged.empty() && sameStyle(merged.back(), seg))
+            merged.back().text += seg.text;
+        else
+            merged.push_back(std::move(seg));
+    }
+    if (merged.empty()) merged.emplace_back();
+    return merged;
+}
+
+bool StatusText::update(std::string_view text) {
+    auto hash = fnv1a(text);
+    if (m_valid && hash == m_hash) return false;
+    m_segments = parse(text);
+    m_hash = hash;
+    m_valid = true;
+    return true;
+}
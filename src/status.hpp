@@ -0,0 +1,56 @@
+#ifndef DWM_STATUS_HPP
+#define DWM_STATUS_HPP
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Status text (the root window's name) split into differently colored segments.
+ *
+ * The text can contain these escapes:
+ *   `^c#RRGGBB^` set the foreground color
+ *   `^b#RRGGBB^` set the background color
+ *   `^s<name>^`  use the color scheme `<name>` from config.hpp (e.g. `^sinfo_sel^`), clears `^c^` and `^b^`
+ *   `^d^`        go back to the default (`status`) colors
+ *   `^^`         a literal `^`
+ * Anything else starting with `^` is drawn as is.
+ */
+struct StatusText {
+    struct Segment {
+        std::string text;
+        /// Scheme selected with `^s^`, empty for the default
+        std::string scheme;
+        /// 0xRRGGBB
+        std::optional<std::uint32_t> fg;
+        std::optional<std::uint32_t> bg;
+    };
+private:
+    std::vector<Segment> m_segments;
+    std::uint64_t m_hash = 0;
+    bool m_valid = false;
+
+public:
+    /// Parse `text` unless it is the same as last time. Returns true if the segments changed.
+    bool update(std::string_view text);
+
+    /// There is always at least one segment, the text of which may be empty
+    [[nodiscard]]
+    std::span<Segment const> segments() const {
+        return m_segments;
+    }
+
+    /// Hash of the unparsed text
+    [[nodiscard]]
+    std::uint64_t hash() const {
+        return m_hash;
+    }
+
+    [[nodiscard]]
+    static std::vector<Segment> parse(std::string_view text);
+};
+
+#endif  // DWM_STATUS_HPP
@@ -0,0 +1,125 @@
+#include "utf8.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#    define DWM_UTF8_X86
+#endif
+
+namespace utf8 {
+
+static constexpr std::size_t max_len = 4;
+static constexpr char32_t min_value[max_len + 1] = {0, 0, 0x80, 0x800, 0x10000};
+static constexpr char32_t max_value[max_len + 1] = {0x10FFFF, 0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
+
+/// Sequence length from the lead byte, 0 for continuation bytes and bytes which can never start a sequence
+static constexpr std::size_t sequenceLength(unsigned char c) {
+    if (c < 0x80) return 1;
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return 0;
+}
+
+[[gnu::always_inline]]
+static inline Codepoint decodeAt(unsigned char const *p, std::size_t size) {
+    auto const lead = p[0];
+    auto const len = sequenceLength(lead);
+    if (len == 0) return {.value = invalid, .len = 1};
+    if (len == 1) return {.value = lead, .len = 1};
+
+    char32_t value = lead & (0x7Fu >> len);
+    for (std::size_t i = 1; i < len; i++) {
+        // the end of the text behaves like the terminating NUL of a C string
+        auto const c = i < size ? p[i] : 0u;
+        if ((c & 0xC0) != 0x80) return {.value = invalid, .len = static_cast<std::uint8_t>(i)};
+        value = (value << 6) | (c & 0x3F);
+    }
+    if (!between(value, min_value[len], max_value[len]) || between(value, 0xD800u, 0xDFFFu)) value = invalid;
+    return {.value = value, .len = static_cast<std::uint8_t>(len)};
+}
+
+Codepoint decodeOne(std::string_view text) {
+    return decodeAt(reinterpret_cast<unsigned char const *>(text.data()), text.size());
+}
+
+static std::size_t asciiPrefixScalar(unsigned char const *p, std::size_t size) {
+    std::size_t i = 0;
+    while (i < size && p[i] < 0x80)
+        i++;
+    return i;
+}
+
+#ifdef DWM_UTF8_X86
+[[gnu::target("avx2")]]
+static std::size_t asciiPrefixAvx2(unsigned char const *p, std::size_t size) {
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        auto mask = (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + i)));
+        if (mask) return i + (std::size_t)std::countr_zero(mask);
+    }
+    return i + asciiPrefixScalar(p + i, size - i);
+}
+
+[[gnu::target("sse2")]]
+static std::size_t asciiPrefixSse2(unsigned char const *p, std::size_t size) {
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        auto mask = (unsigned)_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(p + i)));
+        if (mask) return i + (std::size_t)std::countr_zero(mask);
+    }
+    return i + asciiPrefixScalar(p + i, size - i);
+}
+#endif
+
+std::size_t asciiPrefix(std::string_view text) {
+    auto const *p = reinterpret_cast<unsigned char const *>(text.data());
+#ifdef DWM_UTF8_X86
+    static auto const impl = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return asciiPrefixAvx2;
+        if (__builtin_cpu_supports("sse2")) return asciiPrefixSse2;
+        return asciiPrefixScalar;
+    }();
+    return impl(p, text.size());
+#else
+    return asciiPrefixScalar(p, text.size());
+#endif
+}
+
+void decode(std::string_view text, std::vector<Codepoint> &out) {
+    static constexpr std::size_t short_run = 16;
+
+    out.reserve(out.size() + text.size());
+    auto const *p = reinterpret_cast<unsigned char const *>(text.data());
+    std::size_t i = 0;
+    while (i < text.size()) {
+        // ASCII runs between multi-byte sequences are usually a few characters long (spaces, punctuation), only
+        // switch to the vector scan once a run is longer than that
+        auto ascii = asciiPrefixScalar(p + i, std::min(short_run, text.size() - i));
+        if (ascii == short_run) {
+            ascii += asciiPrefix({text.data() + i + short_run, text.size() - i - short_run});
+            auto n = out.size();
+            out.resize(n + ascii);
+            for (std::size_t j = 0; j < ascii; j++)
+                out[n + j] = {.value = p[i + j], .len = 1};
+        } else {
+            for (auto const *c = p + i; c != p + i + ascii; c++)
+                out.push_back({.value = *c, .len = 1});
+        }
+        i += ascii;
+
+        // decode multi-byte sequences until the next ASCII byte
+        while (i < text.size() && p[i] >= 0x80) {
+            auto cp = decodeAt(p + i, text.size() - i);
+            out.push_back(cp);
+            i += cp.len;
+        }
+    }
+}
+
+}  // namespace utf8
@@ -0,0 +1,37 @@
+#ifndef DWM_UTF8_HPP
+#define DWM_UTF8_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace utf8 {
+
+inline constexpr char32_t invalid = 0xFFFD;
+
+struct Codepoint {
+    char32_t value;
+    /// Number of bytes consumed, always at least 1
+    std::uint8_t len;
+};
+
+/**
+ * Decode a single codepoint from the start of `text`, which must not be empty.
+ *
+ * Malformed input decodes to `invalid`: an unexpected continuation byte or an invalid lead byte consumes 1 byte, a
+ * sequence cut short by a non-continuation byte (or the end of `text`) consumes the bytes before it, and overlong
+ * encodings, surrogates and values above U+10FFFF consume the whole sequence.
+ */
+[[nodiscard]]
+Codepoint decodeOne(std::string_view text);
+
+/// Number of ASCII bytes at the start of `text`
+[[nodiscard]]
+std::size_t asciiPrefix(std::string_view text);
+
+/// Decode all of `text`, appending to `out`. Same semantics as calling `decodeOne` repeatedly.
+void decode(std::string_view text, std::vector<Codepoint> &out);
+
+}  // namespace utf8
+
+#endif  // DWM_UTF8_HPP
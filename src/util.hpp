@@ -6,7 +6,9 @@
 
 #include <algorithm>
 #include <concepts>
+#include <cstdint>
 #include <functional>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #ifndef NDEBUG
@@ -25,6 +27,15 @@ constexpr auto between(auto x, auto a, auto b) {
     return a <= x && x <= b;
 }
 
+/// 64 bit FNV-1a, pass the previous result as `hash` to hash several strings together
+constexpr std::uint64_t fnv1a(std::string_view str, std::uint64_t hash = 0xcbf29ce484222325) {
+    for (auto c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
 void delay(int delay_for, void (*fn)(void *), void *arg);
 
 template<typename R, typename E, typename Cmp>
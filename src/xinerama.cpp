@@ -10,6 +10,12 @@ bool xineramaIsActive(Display *dpy) {
     return XineramaIsActive(dpy) == True;
 }
 
+std::vector<int> selectScreenChanges(Display *, Window) {
+    return {};
+}
+
+void screenChanged(XEvent *) { }
+
 ScreenInfoPtr::~ScreenInfoPtr() {
     free();
 }
@@ -26,6 +32,7 @@ ScreenInfo ScreenInfoPtr::operator[](std::size_t idx) const noexcept {
         .y_org = infos[idx].y_org,
         .width = infos[idx].width,
         .height = infos[idx].height,
+        .id = 0,
     };
 }
 
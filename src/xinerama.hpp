@@ -4,15 +4,30 @@
 #include <X11/Xlib.h>
 
 #include <utility>
+#include <vector>
+
+/*
+ * Screen layout backends: randr.cpp (RandR 1.5 monitors), xinerama.cpp and noxinerama.cpp. Only one of them is
+ * compiled in, see src/CMakeLists.txt.
+ */
 
 bool xineramaIsActive(Display *);
 
+/// Ask to be told about screen changes. Returns the event types which will be sent, empty if the backend only has the
+/// root window ConfigureNotify.
+std::vector<int> selectScreenChanges(Display *, Window root);
+
+/// Update Xlib's idea of the screen from one of the events `selectScreenChanges` returned, or a root ConfigureNotify
+void screenChanged(XEvent *);
+
 struct ScreenInfo {
     int screen_number;
     short x_org;
     short y_org;
     short width;
     short height;
+    /// Stays the same while the output is connected (the RandR monitor name), 0 if the backend has no such thing
+    unsigned long id;
 };
 
 struct ScreenInfoPtr {
@@ -39,7 +54,9 @@ public:
     ScreenInfoPtr &operator=(ScreenInfoPtr &&other) noexcept {
         if (this != &other) {
             free();
+            m_dpy = other.m_dpy;
             m_infos = std::exchange(other.m_infos, nullptr);
+            m_count = other.m_count;
         }
         return *this;
     }
@@ -0,0 +1,68 @@
+#include "xsync.hpp"
+
+#include "log.hpp"
+
+#include <X11/extensions/sync.h>
+#include <X11/Xlib.h>
+
+static int error_base = -1;
+
+static XSyncValue toXSync(std::uint64_t value) {
+    XSyncValue out;
+    XSyncIntsToValue(&out, static_cast<unsigned>(value & 0xffff'ffffu), static_cast<int>(value >> 32u));
+    return out;
+}
+
+static std::uint64_t fromXSync(XSyncValue value) {
+    return static_cast<std::uint64_t>(static_cast<std::uint32_t>(XSyncValueHigh32(value))) << 32u
+         | XSyncValueLow32(value);
+}
+
+std::optional<int> syncInit(Display *dpy) {
+    int event_base = 0;
+    int major = 0;
+    int minor = 0;
+    if (!XSyncQueryExtension(dpy, &event_base, &error_base) || !XSyncInitialize(dpy, &major, &minor)) {
+        lg::warn("XSync is not available, resizing will not wait for clients to redraw");
+        error_base = -1;
+        return std::nullopt;
+    }
+    return event_base + XSyncAlarmNotify;
+}
+
+std::optional<std::uint64_t> syncCounterValue(Display *dpy, XID counter) {
+    XSyncValue value;
+    if (!XSyncQueryCounter(dpy, counter, &value)) return std::nullopt;
+    return fromXSync(value);
+}
+
+void syncSetAlarm(Display *dpy, XID &alarm, XID counter, std::uint64_t value) {
+    XSyncAlarmAttributes attr;
+    attr.trigger.counter = counter;
+    attr.trigger.value_type = XSyncAbsolute;
+    attr.trigger.wait_value = toXSync(value);
+    attr.trigger.test_type = XSyncPositiveComparison;
+    /* go off once, the next request moves the alarm */
+    XSyncIntToValue(&attr.delta, 0);
+    attr.events = True;
+    auto const mask = XSyncCACounter | XSyncCAValueType | XSyncCAValue | XSyncCATestType | XSyncCADelta | XSyncCAEvents;
+    if (alarm == None)
+        alarm = XSyncCreateAlarm(dpy, mask, &attr);
+    else
+        XSyncChangeAlarm(dpy, alarm, mask, &attr);
+}
+
+void syncDestroyAlarm(Display *dpy, XID alarm) {
+    XSyncDestroyAlarm(dpy, alarm);
+}
+
+bool syncIsCounterError(XErrorEvent const *ee) {
+    return error_base >= 0
+        && (ee->error_code == error_base + XSyncBadCounter || ee->error_code == error_base + XSyncBadAlarm);
+}
+
+SyncAlarmNotify syncAlarmNotify(XEvent *ev) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto const *an = reinterpret_cast<XSyncAlarmNotifyEvent const *>(ev);
+    return {.alarm = an->alarm, .value = fromXSync(an->counter_value)};
+}
@@ -0,0 +1,37 @@
+#ifndef DWM_XSYNC_HPP
+#define DWM_XSYNC_HPP
+
+#include <X11/Xlib.h>
+
+#include <cstdint>
+#include <optional>
+
+/*
+ * XSync counters and alarms for _NET_WM_SYNC_REQUEST. xsync.cpp is compiled in when Xext has the extension,
+ * noxsync.cpp otherwise.
+ */
+
+/// Initialise the extension. Returns the type of the alarm notify event, nothing if the server does not have XSync.
+std::optional<int> syncInit(Display *);
+
+/// Current value of `counter`, nothing if it does not exist
+std::optional<std::uint64_t> syncCounterValue(Display *, XID counter);
+
+/// Point `alarm` (created if None) at `counter`, it goes off once the counter reaches `value`
+void syncSetAlarm(Display *, XID &alarm, XID counter, std::uint64_t value);
+
+void syncDestroyAlarm(Display *, XID alarm);
+
+/// The error is about a counter (or an alarm on one) that no longer exists, clients can destroy theirs at any time
+bool syncIsCounterError(XErrorEvent const *);
+
+struct SyncAlarmNotify {
+    XID alarm;
+    /// Value of the counter when the alarm went off
+    std::uint64_t value;
+};
+
+/// Read the alarm notify event `syncInit` returned the type of
+SyncAlarmNotify syncAlarmNotify(XEvent *);
+
+#endif  // DWM_XSYNC_HPP
@@ -0,0 +1,32 @@
+#ifndef DWM_TESTS_BENCH_HPP
+#define DWM_TESTS_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace bench {
+
+/// Keep the compiler from optimizing away the computation of `value`
+template<typename T>
+inline void keep(T const &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Best time of `rounds` rounds of `iterations` calls to `fn`, in nanoseconds per call
+template<typename Fn>
+double run(Fn &&fn, std::size_t iterations, std::size_t rounds = 5) {
+    using Clock = std::chrono::steady_clock;
+    auto best = Clock::duration::max();
+    for (std::size_t r = 0; r < rounds; r++) {
+        auto const start = Clock::now();
+        for (std::size_t i = 0; i < iterations; i++)
+            fn();
+        best = std::min(best, Clock::now() - start);
+    }
+    return std::chrono::duration<double, std::nano>(best).count() / static_cast<double>(iterations);
+}
+
+}  // namespace bench
+
+#endif  // DWM_TESTS_BENCH_HPP
@@ -0,0 +1,200 @@
+/*
+ * Bar frames drawn the way drw.cpp does with and without RASTER_BAR: rectangles and text into a pixmap with
+ * XFillRectangle and Xft and an XCopyArea to the window, or into a RasterImage and one put. Every frame ends with an
+ * XSync, as the server has to be done with a shared memory image before it is drawn into again.
+ *
+ * Needs an X server (e.g. Xvfb), exits with 77 (skipped) without one. Usage: raster_bench [frames] [font]
+ */
+#include "bench.hpp"
+#include "raster.hpp"
+
+#include <X11/Xft/Xft.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <vector>
+
+struct Segment {
+    std::string text;
+    bool selected;
+};
+
+/* Something like a bar on a 1920 pixel wide monitor: tags, layout symbol, title and a colored status */
+static std::vector<Segment> const segments = {
+    {"1", true},
+    {"2", false},
+    {"3", false},
+    {"4", false},
+    {"5", false},
+    {"6", false},
+    {"7", false},
+    {"8", false},
+    {"9", false},
+    {"[]=", false},
+    {"vim src/drw.cpp - \xE2\x80\x9Craster bar\xE2\x80\x9D", true},
+    {" \xE2\x96\xB2 12% ", false},
+    {" mem 3.4G/15.5G ", true},
+    {" wlan0 54Mb/s ", false},
+    {" Sat 17 Oct 14:03 ", true},
+};
+
+struct Bar {
+    Display *dpy;
+    int screen;
+    Window win;
+    GC gc;
+    XftFont *font;
+    XftColor fg[2];
+    XftColor bg[2];
+    unsigned int w;
+    unsigned int h;
+};
+
+static int textWidth(Bar const &bar, std::string const &text) {
+    XGlyphInfo ext;
+    XftTextExtentsUtf8(bar.dpy, bar.font, reinterpret_cast<FcChar8 const *>(text.data()), (int)text.size(), &ext);
+    return ext.xOff + bar.font->height;
+}
+
+/* Calls `rect(x, w, selected)` and `text(x, baseline, string, selected)` for every segment */
+template<typename Rect, typename Text>
+static void layout(Bar const &bar, Rect &&rect, Text &&text) {
+    int x = 0;
+    int const baseline = ((int)bar.h - (bar.font->ascent + bar.font->descent)) / 2 + bar.font->ascent;
+    for (std::size_t i = 0; i < segments.size(); i++) {
+        auto const &s = segments[i];
+        // the title takes up whatever the status does not
+        auto w = i == 10 ? (int)bar.w * 2 / 3 - x : textWidth(bar, s.text);
+        rect(x, w, s.selected);
+        text(x + bar.font->height / 2, baseline, s.text, s.selected);
+        x += w;
+    }
+}
+
+static void drawXft(Bar const &bar, Pixmap pixmap, XftDraw *draw) {
+    layout(
+        bar,
+        [&](int x, int w, bool sel) {
+            XSetForeground(bar.dpy, bar.gc, bar.bg[sel].pixel);
+            XFillRectangle(bar.dpy, pixmap, bar.gc, x, 0, (unsigned)w, bar.h);
+        },
+        [&](int x, int y, std::string const &text, bool sel) {
+            XftDrawStringUtf8(draw,
+                &bar.fg[sel],
+                bar.font,
+                x,
+                y,
+                reinterpret_cast<FcChar8 const *>(text.data()),
+                (int)text.size());
+        });
+    XCopyArea(bar.dpy, pixmap, bar.win, bar.gc, 0, 0, bar.w, bar.h, 0, 0);
+}
+
+static void drawRaster(Bar const &bar, RasterImage &image) {
+    layout(
+        bar,
+        [&](int x, int w, bool sel) {
+            image.fill({(short)x, 0, (unsigned short)w, (unsigned short)bar.h}, bar.bg[sel].pixel);
+        },
+        [&](int x, int y, std::string const &text, bool sel) { image.drawText(bar.font, bar.fg[sel], x, y, text); });
+    image.put(bar.win, bar.gc, 0, 0, bar.w, bar.h);
+}
+
+struct Result {
+    double fps;
+    double requests;
+};
+
+template<typename Fn>
+static Result measure(Display *dpy, unsigned long frames, Fn &&draw) {
+    // fill the glyph caches
+    draw();
+    XSync(dpy, False);
+
+    auto const start_request = NextRequest(dpy);
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < frames; i++) {
+        draw();
+        XSync(dpy, False);
+    }
+    auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // XSync itself is one request per frame, do not count it
+    auto const requests = NextRequest(dpy) - start_request - frames;
+    return {
+        .fps = static_cast<double>(frames) / seconds,
+        .requests = static_cast<double>(requests) / static_cast<double>(frames),
+    };
+}
+
+int main(int argc, char **argv) {
+    auto const frames = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 2'000ul;
+    auto const *const font_name = argc > 2 ? argv[2] : "monospace:size=10";
+
+    Bar bar {};
+    if (!(bar.dpy = XOpenDisplay(nullptr))) {
+        std::println(stderr, "cannot open display, skipping");
+        return 77;
+    }
+    bar.screen = DefaultScreen(bar.dpy);
+    auto const visual = DefaultVisual(bar.dpy, bar.screen);
+    auto const cmap = DefaultColormap(bar.dpy, bar.screen);
+    auto const depth = (unsigned)DefaultDepth(bar.dpy, bar.screen);
+    if (!(bar.font = XftFontOpenName(bar.dpy, bar.screen, font_name))) {
+        std::println(stderr, "cannot load font '{}'", font_name);
+        return EXIT_FAILURE;
+    }
+    char const *const colors[2][2] = {{"#bbbbbb", "#222222"}, {"#eeeeee", "#005577"}};
+    for (int sel = 0; sel < 2; sel++) {
+        XftColorAllocName(bar.dpy, visual, cmap, colors[sel][0], &bar.fg[sel]);
+        XftColorAllocName(bar.dpy, visual, cmap, colors[sel][1], &bar.bg[sel]);
+    }
+    bar.w = 1920;
+    bar.h = (unsigned)(bar.font->height + 2);
+
+    XSetWindowAttributes wa {};
+    wa.override_redirect = True;
+    bar.win = XCreateWindow(bar.dpy,
+        RootWindow(bar.dpy, bar.screen),
+        0,
+        0,
+        bar.w,
+        bar.h,
+        0,
+        (int)depth,
+        CopyFromParent,
+        visual,
+        CWOverrideRedirect,
+        &wa);
+    XMapRaised(bar.dpy, bar.win);
+    bar.gc = XCreateGC(bar.dpy, bar.win, 0, nullptr);
+    XSync(bar.dpy, False);
+
+    std::println("{:<8} {:>10} {:>14}", "backend", "frames/s", "requests/frame");
+
+    auto const pixmap = XCreatePixmap(bar.dpy, bar.win, bar.w, bar.h, depth);
+    auto *const draw = XftDrawCreate(bar.dpy, pixmap, visual, cmap);
+    auto const xft = measure(bar.dpy, frames, [&] { drawXft(bar, pixmap, draw); });
+    std::println("{:<8} {:>10.0f} {:>14.1f}", "xft", xft.fps, xft.requests);
+    XftDrawDestroy(draw);
+    XFreePixmap(bar.dpy, pixmap);
+
+    if (!rasterIsAvailable()) {
+        std::println("{:<8} {:>10} {:>14}", "raster", "-", "-");
+    } else if (auto image = RasterImage::create(bar.dpy, bar.screen, bar.w, bar.h)) {
+        auto const raster = measure(bar.dpy, frames, [&] { drawRaster(bar, *image); });
+        std::println("{:<8} {:>10.0f} {:>14.1f}", "raster", raster.fps, raster.requests);
+    } else {
+        std::println(stderr, "cannot create a raster image on this display");
+    }
+
+    rasterFontClosed(bar.font);
+    XftFontClose(bar.dpy, bar.font);
+    XFreeGC(bar.dpy, bar.gc);
+    XDestroyWindow(bar.dpy, bar.win);
+    XCloseDisplay(bar.dpy);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+/*
+ * StatusText on 1-4 KiB status lines: a full parse, which happens when the root window's name changes, and update
+ * with the same text, which is all a redraw of an unchanged status costs. Usage: status_bench [iterations]
+ */
+#include "bench.hpp"
+#include "status.hpp"
+
+#include <cstdlib>
+#include <print>
+#include <string>
+
+/* Status line of about `size` bytes, a colored block every `escape_every` blocks */
+static std::string statusLine(std::size_t size, std::size_t escape_every) {
+    static constexpr std::string_view blocks[] = {
+        " cpu 12% ", " mem 3.4G/15.5G ", " wlan0 54Mb/s ", " vol 35% ", " bat 80% ^^ ", " Sat 17 Oct 14:03 ",
+    };
+    static constexpr std::string_view escapes[] = {"^c#ff5555^", "^b#282a36^", "^sinfo_sel^", "^d^"};
+
+    std::string out;
+    for (std::size_t i = 0; out.size() < size; i++) {
+        if (escape_every && i % escape_every == 0) out += escapes[i / escape_every % std::size(escapes)];
+        out += blocks[i % std::size(blocks)];
+        out += '|';
+    }
+    out.resize(size);
+    return out;
+}
+
+int main(int argc, char **argv) {
+    auto const iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 20'000ul;
+
+    std::println("{:>6} {:>8} {:>9} {:>12} {:>12}", "bytes", "escapes", "segments", "parse ns", "unchanged ns");
+    for (auto size : {1024uz, 2048uz, 4096uz}) {
+        for (auto escape_every : {0uz, 4uz, 1uz}) {
+            auto const text = statusLine(size, escape_every);
+            auto const segments = StatusText::parse(text).size();
+            auto const parse_ns = bench::run([&] { bench::keep(StatusText::parse(text)); }, iterations);
+
+            StatusText status;
+            status.update(text);
+            auto const update_ns = bench::run([&] { bench::keep(status.update(text)); }, iterations);
+
+            std::println("{:>6} {:>8} {:>9} {:>12.0f} {:>12.0f}",
+                size,
+                escape_every ? "1/" + std::to_string(escape_every) : std::string {"none"},
+                segments,
+                parse_ns,
+                update_ns);
+        }
+    }
+    return EXIT_SUCCESS;
+}
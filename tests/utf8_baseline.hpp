@@ -0,0 +1,78 @@
+#ifndef DWM_TESTS_UTF8_BASELINE_HPP
+#define DWM_TESTS_UTF8_BASELINE_HPP
+
+/*
+ * The UTF-8 decoder from drw.cpp before it was replaced by utf8.cpp, kept unchanged as the reference for
+ * utf8_test and utf8_bench. It was always called with `clen = UTF_SIZ` on NUL terminated strings.
+ */
+
+#include "util.hpp"
+
+#include <cstddef>
+
+namespace baseline {
+
+#define UTF_INVALID 0xFFFD
+#define UTF_SIZ     4uz
+
+static unsigned char const utfbyte[UTF_SIZ + 1] = {0x80, 0, 0xC0, 0xE0, 0xF0};
+static unsigned char const utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
+static long const utfmin[UTF_SIZ + 1] = {0, 0, 0x80, 0x800, 0x10000};
+static long const utfmax[UTF_SIZ + 1] = {0x10FFFF, 0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
+
+static long utf8decodebyte(char const c, size_t *i) {
+    for (*i = 0; *i < (UTF_SIZ + 1); ++(*i)) {
+        if (((unsigned char)c & utfmask[*i]) == utfbyte[*i]) {
+            return (unsigned char)c & ~utfmask[*i];
+        }
+    }
+    return 0;
+}
+
+static size_t utf8validate(long *u, size_t i) {
+    if (!between(*u, utfmin[i], utfmax[i]) || between(*u, 0xD800, 0xDFFF)) {
+        *u = UTF_INVALID;
+    }
+    for (i = 1; *u > utfmax[i]; ++i) {
+        ;
+    }
+
+    return i;
+}
+
+static size_t utf8decode(char const *c, long *u, size_t clen) {
+    size_t i;
+    size_t j;
+    size_t len;
+    size_t type;
+    long udecoded;
+
+    *u = UTF_INVALID;
+    if (!clen) {
+        return 0;
+    }
+    udecoded = utf8decodebyte(c[0], &len);
+    if (!between(len, 1uz, UTF_SIZ)) {
+        return 1;
+    }
+    for (i = 1, j = 1; i < clen && j < len; ++i, ++j) {
+        udecoded = (udecoded << 6) | utf8decodebyte(c[i], &type);
+        if (type) {
+            return j;
+        }
+    }
+    if (j < len) {
+        return 0;
+    }
+    *u = udecoded;
+    utf8validate(u, len);
+
+    return len;
+}
+
+#undef UTF_SIZ
+#undef UTF_INVALID
+
+}  // namespace baseline
+
+#endif  // DWM_TESTS_UTF8_BASELINE_HPP
@@ -0,0 +1,70 @@
+/*
+ * Decoding throughput of utf8.cpp against the decoder it replaced (utf8_baseline.hpp), on status text shaped input.
+ * Usage: utf8_bench [iterations]
+ */
+#include "bench.hpp"
+#include "utf8.hpp"
+#include "utf8_baseline.hpp"
+
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <vector>
+
+/* How drw.cpp used to walk a string */
+static std::size_t decodeBaseline(std::string const &text, std::vector<utf8::Codepoint> &out) {
+    auto const *c = text.c_str();
+    for (std::size_t i = 0; i < text.size();) {
+        long u;
+        auto len = baseline::utf8decode(c + i, &u, 4);
+        out.push_back({.value = static_cast<char32_t>(u), .len = static_cast<std::uint8_t>(len)});
+        i += len;
+    }
+    return out.size();
+}
+
+static std::string repeat(std::string_view piece, std::size_t size) {
+    std::string out;
+    while (out.size() < size)
+        out += piece;
+    return out;
+}
+
+int main(int argc, char **argv) {
+    auto const iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 20'000ul;
+
+    struct Input {
+        char const *name;
+        std::string text;
+    };
+    Input const inputs[] = {
+        {"ascii status", repeat(" | cpu 12% | mem 3.4G/15.5G | wlan0 up 54Mb/s | Sat 17 Oct 14:03 ", 2048)},
+        {"ascii + symbols", repeat(" \xEF\x80\x87 12% \xEF\x87\xAB 54Mb/s \xE2\x96\xB2 3.4G \xEF\x80\xA8 42% ", 2048)},
+        {"cjk", repeat("\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE3\x83\x86\xE3\x82\xAD\xE3\x82\xB9\xE3\x83\x88 ", 2048)},
+        {"emoji", repeat("\xF0\x9F\x94\x8B 80% \xF0\x9F\x94\x8A 35% \xF0\x9F\x93\xB6 ", 2048)},
+    };
+
+    std::println("{:<16} {:>7} {:>14} {:>14} {:>8}", "input", "bytes", "baseline ns/B", "utf8 ns/B", "speedup");
+    std::vector<utf8::Codepoint> out;
+    for (auto const &[name, text] : inputs) {
+        out.reserve(text.size());
+        auto const bytes = static_cast<double>(text.size());
+        auto const old_ns = bench::run(
+                                [&] {
+                                    out.clear();
+                                    bench::keep(decodeBaseline(text, out));
+                                },
+                                iterations) /
+                            bytes;
+        auto const new_ns = bench::run(
+                                [&] {
+                                    out.clear();
+                                    utf8::decode(text, out);
+                                    bench::keep(out.size());
+                                },
+                                iterations) /
+                            bytes;
+        std::println("{:<16} {:>7} {:>14.3f} {:>14.3f} {:>7.2f}x", name, text.size(), old_ns, new_ns, old_ns / new_ns);
+    }
+    return EXIT_SUCCESS;
+}
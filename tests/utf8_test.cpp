@@ -0,0 +1,196 @@
+/*
+ * Differential test of utf8.cpp against the decoder it replaced (utf8_baseline.hpp).
+ *
+ * The old decoder read NUL terminated strings, so the inputs never contain NUL and the end of the text stands in for
+ * it. Usage: utf8_test [seed] [iterations]
+ */
+#include "utf8.hpp"
+#include "utf8_baseline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<utf8::Codepoint> decodeBaseline(std::string const &text) {
+    std::vector<utf8::Codepoint> out;
+    auto const *c = text.c_str();
+    for (std::size_t i = 0; i < text.size();) {
+        long u;
+        auto len = baseline::utf8decode(c + i, &u, 4);
+        out.push_back({.value = static_cast<char32_t>(u), .len = static_cast<std::uint8_t>(len)});
+        i += std::max(len, 1uz);
+    }
+    return out;
+}
+
+static bool operator==(utf8::Codepoint a, utf8::Codepoint b) {
+    return a.value == b.value && a.len == b.len;
+}
+
+static void dump(std::string const &text) {
+    std::print(stderr, "  input:");
+    for (auto c : text)
+        std::print(stderr, " {:02x}", static_cast<unsigned char>(c));
+    std::println(stderr, "");
+}
+
+static bool check(std::string const &text) {
+    auto const expected = decodeBaseline(text);
+
+    std::vector<utf8::Codepoint> actual;
+    utf8::decode(text, actual);
+    auto const n = std::min(expected.size(), actual.size());
+    for (std::size_t i = 0; i < n; i++) {
+        if (!(expected[i] == actual[i])) {
+            std::println(stderr,
+                "decode: codepoint {} is U+{:04X} ({} bytes), expected U+{:04X} ({} bytes)",
+                i,
+                static_cast<std::uint32_t>(actual[i].value),
+                actual[i].len,
+                static_cast<std::uint32_t>(expected[i].value),
+                expected[i].len);
+            dump(text);
+            return false;
+        }
+    }
+    if (expected.size() != actual.size()) {
+        std::println(stderr, "decode: {} codepoints, expected {}", actual.size(), expected.size());
+        dump(text);
+        return false;
+    }
+
+    std::size_t pos = 0;
+    for (auto const &cp : expected) {
+        auto one = utf8::decodeOne(std::string_view {text}.substr(pos));
+        if (!(one == cp)) {
+            std::println(stderr,
+                "decodeOne: at byte {} got U+{:04X} ({} bytes), expected U+{:04X} ({} bytes)",
+                pos,
+                static_cast<std::uint32_t>(one.value),
+                one.len,
+                static_cast<std::uint32_t>(cp.value),
+                cp.len);
+            dump(text);
+            return false;
+        }
+        pos += cp.len;
+    }
+
+    auto const ascii = static_cast<std::size_t>(
+        std::ranges::find_if(text, [](char c) { return static_cast<unsigned char>(c) >= 0x80; }) - text.begin());
+    if (auto got = utf8::asciiPrefix(text); got != ascii) {
+        std::println(stderr, "asciiPrefix: {}, expected {}", got, ascii);
+        dump(text);
+        return false;
+    }
+    return true;
+}
+
+/* Encode `value` in `len` bytes without checking that it fits or is valid, to produce overlong sequences, surrogates
+ * and values above U+10FFFF */
+static void encode(std::string &out, char32_t value, std::size_t len) {
+    static constexpr std::array<unsigned char, 5> lead = {0, 0x00, 0xC0, 0xE0, 0xF0};
+    out += static_cast<char>(lead[len] | (value >> (6 * (len - 1))));
+    for (auto i = len - 1; i-- > 0;)
+        out += static_cast<char>(0x80 | ((value >> (6 * i)) & 0x3F));
+}
+
+static std::string const edge_cases[] = {
+    "",
+    "plain ascii",
+    "\xC3\xA9",                  // é
+    "\xE2\x82\xAC",              // €
+    "\xF0\x9F\x98\x80",          // 😀
+    "\xC0\x80",                  // overlong NUL
+    "\xC1\xBF",                  // overlong U+007F
+    "\xE0\x80\xAF",              // overlong /
+    "\xF0\x8F\xBF\xBF",          // overlong U+FFFF
+    "\xED\xA0\x80",              // U+D800
+    "\xED\xBF\xBF",              // U+DFFF
+    "\xEF\xBF\xBF",              // U+FFFF
+    "\xF4\x8F\xBF\xBF",          // U+10FFFF
+    "\xF4\x90\x80\x80",          // U+110000
+    "\xF7\xBF\xBF\xBF",          // U+1FFFFF
+    "\x80",                      // stray continuation
+    "a\xBF" "b",
+    "\xC3",                      // truncated by the end of the text
+    "\xE2\x82",
+    "\xF0\x9F\x98",
+    "\xC3" "a",                   // truncated by an ASCII byte
+    "\xF0\x9F\xC3\xA9",          // truncated by another lead byte
+    "\xF8\x88\x80\x80\x80",      // 5 byte form
+    "\xFC\x84\x80\x80\x80\x80",  // 6 byte form
+    "\xFE\xFF",
+    "0123456789abcdef0123456789abcdef\xE2\x82\xAC" "0123456789abcdef",
+};
+
+static std::string randomText(std::mt19937 &gen) {
+    static constexpr char32_t interesting[] = {
+        0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xD800, 0xDFFF, 0xE000, 0xFFFD, 0xFFFF, 0x10000, 0x10FFFF, 0x110000,
+    };
+    auto roll = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t> {0, n - 1}(gen); };
+
+    std::string text;
+    for (auto pieces = roll(12); pieces-- > 0;) {
+        switch (roll(5)) {
+            case 0: {
+                // long enough to go through the vector scan in utf8::decode
+                for (auto n = roll(48); n-- > 0;)
+                    text += static_cast<char>(0x20 + roll(0x5F));
+                break;
+            }
+            case 1: text += static_cast<char>(1 + roll(0xFF)); break;
+            case 2: {
+                auto len = 2 + roll(3);
+                auto value = static_cast<char32_t>(roll(std::size_t {1} << (len == 2 ? 11 : len == 3 ? 16 : 21)));
+                encode(text, value, len);
+                break;
+            }
+            case 3: {
+                auto value = interesting[roll(std::size(interesting))];
+                auto len = value < 0x80 ? 1uz : value < 0x800 ? 2uz : value < 0x10000 ? 3uz : 4uz;
+                // sometimes overlong
+                len = std::min(len + (roll(4) == 0), 4uz);
+                encode(text, value, len);
+                break;
+            }
+            case 4: {
+                // valid sequence cut short
+                std::string cp;
+                encode(cp, static_cast<char32_t>(0x10000 + roll(0x100000)), 4);
+                text += cp.substr(0, 1 + roll(3));
+                break;
+            }
+            default: break;
+        }
+    }
+    return text;
+}
+
+int main(int argc, char **argv) {
+    auto const seed = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 0x6477'6d75ul;
+    auto const iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 200'000ul;
+
+    std::size_t failed = 0;
+    for (auto const &text : edge_cases)
+        failed += !check(text);
+
+    std::mt19937 gen {static_cast<std::mt19937::result_type>(seed)};
+    for (unsigned long i = 0; i < iterations && failed < 10; i++)
+        failed += !check(randomText(gen));
+
+    if (failed) {
+        std::println(stderr, "{} inputs decoded differently (seed {:#x})", failed, seed);
+        return EXIT_FAILURE;
+    }
+    std::println("{} edge cases and {} random inputs decoded the same (seed {:#x})",
+        std::size(edge_cases),
+        iterations,
+        seed);
+    return EXIT_SUCCESS;
+}